@@ -1,4 +1,9 @@
 mkdir dest obj
+# The compressed base scene is smaller to download, so it is baked with a
+# native build of the bake tool and preloaded instead of the text scene
+cmake -S . -B obj/native -DCMAKE_BUILD_TYPE=Release || exit 1
+cmake --build obj/native --target marblerun_bake || exit 1
+obj/native/marblerun_bake base.scene base.cscene --compress || exit 1
 emcc -c src/main.cpp -o obj/main.o -I include -s USE_SDL=2
 emcc -c src/Shaders.cpp -o obj/Shaders.o -I include -s USE_SDL=2
 emcc -c src/Matrix.cpp -o obj/Matrix.o -I include -s USE_SDL=2
@@ -9,4 +14,28 @@ emcc -c src/Model.cpp -o obj/Model.o -I include -s USE_SDL=2
 emcc -c src/SphereModel.cpp -o obj/SphereModel.o -I include -s USE_SDL=2
 emcc -c src/ObjModel.cpp -o obj/ObjModel.o -I include -s USE_SDL=2
 emcc -c src/Ball.cpp -o obj/Ball.o -I include -s USE_SDL=2
-emcc -O3 -flto -fno-rtti obj/main.o obj/Shaders.o obj/Scene3D.o obj/Matrix.o obj/Vec3.o obj/Camera.o obj/Model.o obj/SphereModel.o obj/ObjModel.o obj/Ball.o -s WASM=1 -s ALLOW_MEMORY_GROWTH=1 -o dest/index.html --shell-file index.html -s USE_SDL=2 -s "EXPORTED_RUNTIME_METHODS=['ccall', 'cwrap']" -s EXPORTED_FUNCTIONS='["_SDLEv_dropEventForSDL","_SDLEv_browserWasResized","_main"]' -s FORCE_FILESYSTEM=1 --preload-file base.scene
+emcc -c src/ContactArena.cpp -o obj/ContactArena.o -I include -s USE_SDL=2
+emcc -c src/BallStore.cpp -o obj/BallStore.o -I include -s USE_SDL=2
+emcc -c src/BallEmitter.cpp -o obj/BallEmitter.o -I include -s USE_SDL=2
+emcc -c src/Mesh.cpp -o obj/Mesh.o -I include -s USE_SDL=2
+emcc -c src/Simulation.cpp -o obj/Simulation.o -I include -s USE_SDL=2
+emcc -c src/FrameRecorder.cpp -o obj/FrameRecorder.o -I include -s USE_SDL=2
+emcc -c src/Hud.cpp -o obj/Hud.o -I include -s USE_SDL=2
+emcc -c src/LatencyHistogram.cpp -o obj/LatencyHistogram.o -I include -s USE_SDL=2
+emcc -c src/MetricsLog.cpp -o obj/MetricsLog.o -I include -s USE_SDL=2
+emcc -c src/CollisionHeatmap.cpp -o obj/CollisionHeatmap.o -I include -s USE_SDL=2
+emcc -c src/HeatmapOverlay.cpp -o obj/HeatmapOverlay.o -I include -s USE_SDL=2
+emcc -c src/InputRecording.cpp -o obj/InputRecording.o -I include -s USE_SDL=2
+emcc -c src/GoldenTrajectory.cpp -o obj/GoldenTrajectory.o -I include -s USE_SDL=2
+emcc -c src/MemoryStats.cpp -o obj/MemoryStats.o -I include -s USE_SDL=2
+emcc -c src/SceneParser.cpp -o obj/SceneParser.o -I include -s USE_SDL=2
+emcc -c src/BakedScene.cpp -o obj/BakedScene.o -I include -s USE_SDL=2
+emcc -c src/MappedFile.cpp -o obj/MappedFile.o -I include -s USE_SDL=2
+emcc -c src/CompressedScene.cpp -o obj/CompressedScene.o -I include -s USE_SDL=2
+emcc -c src/SceneLoader.cpp -o obj/SceneLoader.o -I include -s USE_SDL=2
+emcc -c src/SceneWriter.cpp -o obj/SceneWriter.o -I include -s USE_SDL=2
+emcc -c src/StateSnapshot.cpp -o obj/StateSnapshot.o -I include -s USE_SDL=2
+emcc -c src/SceneCache.cpp -o obj/SceneCache.o -I include -s USE_SDL=2
+emcc -c src/MeshPatch.cpp -o obj/MeshPatch.o -I include -s USE_SDL=2
+emcc -c src/WorldStreamer.cpp -o obj/WorldStreamer.o -I include -s USE_SDL=2
+emcc -O3 -flto -fno-rtti obj/main.o obj/Shaders.o obj/Scene3D.o obj/Matrix.o obj/Vec3.o obj/Camera.o obj/Model.o obj/SphereModel.o obj/ObjModel.o obj/Ball.o obj/ContactArena.o obj/BallStore.o obj/BallEmitter.o obj/Mesh.o obj/Simulation.o obj/FrameRecorder.o obj/Hud.o obj/LatencyHistogram.o obj/MetricsLog.o obj/CollisionHeatmap.o obj/HeatmapOverlay.o obj/InputRecording.o obj/GoldenTrajectory.o obj/MemoryStats.o obj/SceneParser.o obj/BakedScene.o obj/MappedFile.o obj/CompressedScene.o obj/SceneLoader.o obj/SceneWriter.o obj/StateSnapshot.o obj/SceneCache.o obj/MeshPatch.o obj/WorldStreamer.o -s WASM=1 -s ALLOW_MEMORY_GROWTH=1 -o dest/index.html --shell-file index.html -s USE_SDL=2 -s "EXPORTED_RUNTIME_METHODS=['ccall', 'cwrap']" -s EXPORTED_FUNCTIONS='["_SDLEv_dropEventForSDL","_SDLEv_browserWasResized","_main"]' -s FORCE_FILESYSTEM=1 --preload-file base.cscene
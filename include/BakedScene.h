@@ -0,0 +1,81 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_BAKEDSCENE_H_
+#define _PHY3D_BAKEDSCENE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "Ball.h"
+#include "KillVolume.h"
+#include "Mesh.h"
+
+class Simulation;
+
+/**
+ * The types of the sections of a baked scene file. Sections of unknown types
+ * are skipped by the loader, so new ones can be added without changing the
+ * version.
+ */
+enum BakedSection {
+  BALL_SECTION = 1,    // 8 floats per ball: position, radius and attributes
+  KILL_SECTION = 2,    // 6 floats per kill volume: the two corners
+  VERTEX_SECTION = 3,  // 3 floats per vertex
+  INDEX_SECTION = 4,   // 3 unsigned ints per triangle
+  TILE_SECTION = 5     // 6 floats of the box and 4 unsigned ints per tile
+};
+
+/**
+ * A tile of the world geometry of a scene baked with a tile size. Its
+ * vertices and triangles are contiguous ranges of the vertex and index
+ * sections, and its triangles only use its own vertices.
+ */
+struct BakedTile {
+  Vec3 min, max;  // The box of the vertices of the tile
+  uint32_t firstVertex;
+  uint32_t vertexCount;
+  uint32_t firstTriangle;
+  uint32_t triangleCount;
+};
+
+/**
+ * The tiles of a baked scene and the location of the geometry they refer to,
+ * so the tiles can be read from the file one by one.
+ */
+struct BakedTileIndex {
+  std::vector<BakedTile> tiles;
+  uint64_t vertexOffset;  // The start of the vertex section in the file
+  uint64_t indexOffset;   // The start of the index section in the file
+};
+
+/**
+ * Binary scene format, made to be used without parsing. The file starts with
+ * the magic "MRSB", the version and the number of sections, followed by a
+ * table with the type, element count, offset and size of every section. The
+ * sections are little-endian arrays aligned to 64 bytes, so the vertices and
+ * indices of a memory mapped file are used by the mesh in place. Scenes baked
+ * with a tile size have their geometry ordered tile by tile, with a tile
+ * section describing the tiles, so very large worlds can be streamed.
+ */
+class BakedScene {
+ public:
+  static constexpr uint32_t version = 1;
+  static constexpr size_t alignment = 64;
+
+  static bool isBaked(const char* fileName);
+  static bool save(const char* fileName, const Simulation& sim,
+                   float tileSize = 0);
+  static bool load(const char* fileName, Mesh& mesh, std::vector<Ball>& balls,
+                   std::vector<KillVolume>& killVolumes);
+  static bool loadTiles(const char* fileName, BakedTileIndex& index,
+                        std::vector<Ball>& balls,
+                        std::vector<KillVolume>& killVolumes);
+};
+
+#endif
@@ -10,13 +10,33 @@
 #define _PHY3D_BALL_H_
 
 #include <cmath>
+#include <vector>
 
+#include "CollisionHeatmap.h"
+#include "ContactArena.h"
 #include "Matrix.h"
-#include "Model.h"
+#include "Mesh.h"
 #include "Vec3.h"
 
 enum BallType { OPAQUE_BALL, SHELL_BALL };
 
+/**
+ * The complete dynamic state and the attributes of a ball, everything that is
+ * needed to continue simulating it. It can be copied as plain memory.
+ */
+struct BallState {
+  Vec3 pos;
+  Vec3 vel;
+  Vec3 angVel;
+  Matrix orientation;
+  float radius;
+  float density;
+  float angularMassMultiplier;
+  float bounciness;
+  float frictionCoefficient;
+  unsigned int id;
+};
+
 /**
  * Class that describes a ball that can move and collide with static geometry
  * and other balls.
@@ -33,6 +53,18 @@ class Ball {
       angularMassMultiplier;  // This describes the inner structure of the ball
   float k;                    // Coefficent of restitution
   float fc;                   // Frction coefficient
+  unsigned int id;  // Stable identifier, survives reordering of the balls
+
+  // Verlet-style cache of the world geometry near the ball: the vertices and
+  // triangles within radius + skin distance of cachePos. It stays valid until
+  // the ball moves more than the skin distance away from cachePos.
+  std::vector<unsigned int> nearVertices;
+  std::vector<unsigned int> nearTriangles;
+  Vec3 cachePos;
+  const Mesh* cachedMesh;  // The mesh the cache was built for, or NULL
+
+  float getCacheSkin() const { return 0.5f * r; }
+  void rebuildCache(const Mesh& m);
 
  public:
   Ball(const Vec3& pos_ = Vec3(0, 0, 0), float radius = 1);
@@ -50,6 +82,8 @@ class Ball {
   float getBounciness() const { return k; };
   void setFrictionCoefficient(float fc_) { fc = std::abs(fc_); };
   float getFrictionCoefficient() const { return fc; };
+  void setId(unsigned int newId) { id = newId; }
+  unsigned int getId() const { return id; }
   inline float getAngularMass() const;
   void setAngularMassMultiplier(float newAmm) {
     angularMassMultiplier = std::abs(newAmm);
@@ -58,9 +92,25 @@ class Ball {
   void update(float dt, const Vec3& g = Vec3(0, 0, 0));
   Matrix getModelViewMatrix() const;
   Vec3 getVelInPos(const Vec3& p) const;
-  void collideWithModel(const Model& m);
+  void collideWithModel(const Mesh& m, ContactArena& found);
+  int findContacts(const Mesh& m, int self, ContactArena& contacts,
+                   CollisionHeatmap* heatmap = NULL);
+  void invalidateCache() { cachedMesh = NULL; }
+  bool isCacheValid(const Mesh& m) const;
+  bool cacheOverlaps(const Vec3& min, const Vec3& max) const;
+  bool remapCache(const std::vector<unsigned int>& vertexMap,
+                  const std::vector<unsigned int>& triangleMap);
+  BallState getState() const;
+  void setState(const BallState& s);
+  size_t getCachedTriangleNum() const { return nearTriangles.size(); }
+  size_t getCacheBytes() const {
+    return sizeof(unsigned int) *
+           (nearVertices.capacity() + nearTriangles.capacity());
+  }
+  bool resolveContact(const Vec3& v);
 
-  static void collide(Ball& b1, Ball& b2);
+  static bool overlaps(const Ball& b1, const Ball& b2);
+  static bool collide(Ball& b1, Ball& b2);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_BALL_EMITTER_H_
+#define _PHY3D_BALL_EMITTER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "Ball.h"
+#include "BallStore.h"
+#include "Vec3.h"
+
+enum EmitterPattern {
+  GRID_EMITTER,
+  JITTER_EMITTER,
+  STREAM_EMITTER,
+  EMITTER_PATTERNS
+};
+
+/**
+ * Spawns a given number of balls at a given rate in a pattern: on a grid or at
+ * random positions inside a box, or as a stream shot from a point (usually the
+ * camera). Every spawned ball is a copy of the prototype ball.
+ */
+class BallEmitter {
+ private:
+  EmitterPattern pattern;
+  Ball prototype;
+  int total;            // The number of balls to spawn
+  int spawned;          // The number of balls spawned so far
+  float rate;           // Spawned balls per second
+  float accumulator;    // Fractional balls carried over between updates
+  Vec3 boxMin, boxMax;  // The box for the grid and jittered patterns
+  Vec3 streamFrom;      // The start of the stream
+  Vec3 streamVel;       // The velocity the streamed balls get
+  uint32_t rngState;
+
+  float random();
+  Vec3 nextPosition();
+
+ public:
+  BallEmitter(EmitterPattern pattern_ = STREAM_EMITTER, int count = 0,
+              float ballsPerSecond = 10.0f, const Ball& proto = Ball());
+  void setBox(const Vec3& min, const Vec3& max);
+  void setStream(const Vec3& from, const Vec3& vel);
+  void setSeed(uint32_t seed) { rngState = seed ? seed : 1; }
+  void start(BallStore& store);
+  int update(float dt, BallStore& store);
+  int spawnAll(BallStore& store);
+  bool isFinished() const { return spawned >= total; }
+  int getRemaining() const { return total - spawned; }
+  EmitterPattern getPattern() const { return pattern; }
+};
+
+#endif
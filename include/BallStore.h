@@ -0,0 +1,67 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_BALL_STORE_H_
+#define _PHY3D_BALL_STORE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "Ball.h"
+#include "MemoryStats.h"
+#include "Morton.h"
+
+/**
+ * Growable container of the balls in a scene. The balls are kept in a dense
+ * array for fast iteration, while each ball also gets a stable id that can be
+ * used to find it after the array is reordered or other balls are removed.
+ * Storage grows geometrically and the ids of removed balls are reused.
+ */
+class BallStore {
+ private:
+  Ball* balls;   // Dense array of the balls
+  int count;     // The number of balls in the array
+  int capacity;  // The number of balls the array has space for
+
+  int* slots;              // The index of each id in the balls array, or -1
+  unsigned int idCount;    // The number of ids handed out so far
+  unsigned int idCapacity;
+  unsigned int* freeIds;   // Stack of ids that can be given out again
+  unsigned int freeCount;
+  // The bytes of an id: its slot and its place in the free stack
+  static const int idBytes = sizeof(int) + sizeof(unsigned int);
+
+  void growBalls(int newCapacity);
+  void growIds(unsigned int newCapacity);
+
+ public:
+  BallStore();
+  ~BallStore();
+  BallStore(const BallStore&) = delete;
+  BallStore& operator=(const BallStore&) = delete;
+  void reserve(int n);
+  unsigned int add(const Ball& b);
+  bool remove(unsigned int id);
+  void removeAt(int index);
+  void clear();
+  int size() const { return count; }
+  int getCapacity() const { return capacity; }
+  unsigned int getIdLimit() const { return idCount; }
+  unsigned int getFreeIdCount() const { return freeCount; }
+  const unsigned int* getFreeIds() const { return freeIds; }
+  void restore(const BallState* states, int n, unsigned int idLimit,
+               const unsigned int* free, unsigned int freeNum);
+  Ball& operator[](int i) { return balls[i]; }
+  const Ball& operator[](int i) const { return balls[i]; }
+  Ball* find(unsigned int id);
+  const Ball* find(unsigned int id) const;
+  void sortByMorton();
+};
+
+#endif
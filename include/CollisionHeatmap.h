@@ -0,0 +1,45 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_COLLISION_HEATMAP_H_
+#define _PHY3D_COLLISION_HEATMAP_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "MemoryStats.h"
+#include "Mesh.h"
+
+/**
+ * Counts the narrowphase tests and the contacts of every triangle of the world
+ * over a run, showing which regions of a scene cost the most time. The counts
+ * can be exported as CSV with the centre and the area of each triangle.
+ */
+class CollisionHeatmap {
+ private:
+  std::vector<uint32_t> tests;     // Ball-triangle tests per triangle
+  std::vector<uint32_t> contacts;  // Contacts found per triangle
+
+  int64_t getBytes() const;
+
+ public:
+  ~CollisionHeatmap();
+  void reset(unsigned int triangleNum);
+  unsigned int getTriangleNum() const { return tests.size(); }
+  void addTest(unsigned int triangle) { tests[triangle]++; }
+  void addContact(unsigned int triangle) { contacts[triangle]++; }
+  uint32_t getTests(unsigned int triangle) const { return tests[triangle]; }
+  uint32_t getContacts(unsigned int triangle) const {
+    return contacts[triangle];
+  }
+  uint32_t getMaxTests() const;
+  void writeCsv(std::ostream& os, const Mesh& m) const;
+};
+
+#endif
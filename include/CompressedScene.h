@@ -0,0 +1,40 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_COMPRESSEDSCENE_H_
+#define _PHY3D_COMPRESSEDSCENE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "Ball.h"
+#include "KillVolume.h"
+#include "Mesh.h"
+
+class Simulation;
+
+/**
+ * Compact scene format for downloads. The vertex coordinates are quantized
+ * to a grid with the given step, and the differences between consecutive
+ * vertices and indices are coded with an adaptive range coder. The balls and
+ * kill volumes are stored exactly. The file starts with the magic "MRSC",
+ * the version and the element counts, followed by the coded data.
+ */
+class CompressedScene {
+ public:
+  static constexpr uint32_t version = 1;
+  static constexpr float defaultStep = 1.0f / 1024.0f;
+
+  static bool isCompressed(const char* fileName);
+  static bool save(const char* fileName, const Simulation& sim,
+                   float step = defaultStep);
+  static bool load(const char* fileName, Mesh& mesh, std::vector<Ball>& balls,
+                   std::vector<KillVolume>& killVolumes);
+};
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_CONTACT_ARENA_H_
+#define _PHY3D_CONTACT_ARENA_H_
+
+#include "MemoryStats.h"
+#include "Vec3.h"
+
+/**
+ * A contact found in the detection phase of a physics step. Ball-world
+ * contacts store the touched point of the static geometry, ball-ball contacts
+ * store the index of the other ball.
+ */
+struct Contact {
+  int ball;    // Index of the (first) ball taking part in the contact
+  int other;   // Index of the other ball, -1 if the ball touches the world
+  Vec3 point;  // The touched point of the world geometry
+  int triangle;  // The touched triangle, -1 for vertices and ball contacts
+};
+
+/**
+ * Bump allocated buffer that holds the contacts of a single physics step. It is
+ * reset at the start of every step but keeps its memory, so after the first
+ * few frames no heap allocations happen at all.
+ */
+class ContactArena {
+ private:
+  Contact* contacts;
+  int count;
+  int capacity;
+  int highWaterMark;  // The largest number of contacts seen in a single step
+
+  Contact& push();
+
+ public:
+  ContactArena(int initialCapacity = 1024);
+  ~ContactArena();
+  ContactArena(const ContactArena&) = delete;
+  ContactArena& operator=(const ContactArena&) = delete;
+  void reset() { count = 0; }
+  void addWorldContact(int ball, const Vec3& p, int triangle = -1);
+  void addBallContact(int ball1, int ball2);
+  int getCount() const { return count; }
+  int getCapacity() const { return capacity; }
+  int getHighWaterMark() const { return highWaterMark; }
+  const Contact& operator[](int i) const { return contacts[i]; }
+};
+
+#endif
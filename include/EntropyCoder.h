@@ -0,0 +1,293 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_ENTROPYCODER_H_
+#define _PHY3D_ENTROPYCODER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A small rANS entropy coder with static frequency tables. Numbers are split
+ * into the number of their significant bits, which is entropy coded, and the
+ * bits after the leading one, which are close to random and are written into
+ * a plain bit stream. Decoding a number takes a table lookup, a
+ * multiplication and a few shifts.
+ */
+namespace EntropyCoder {
+const int scaleBits = 12;  // The frequencies of a table add up to 2^scaleBits
+const uint32_t scale = 1 << scaleBits;
+const uint32_t lowerBound = 1 << 16;  // The state is kept above this
+const int symbolNum = 33;             // Bit lengths of 32 bit numbers
+
+/**
+ * Returns the number of significant bits of the value, which is the symbol
+ * it is coded with.
+ */
+inline int bitLength(uint32_t value) {
+  int length = 0;
+  while (value >> length) length++;
+  return length;
+}
+
+/**
+ * Maps signed numbers to unsigned ones so that small magnitudes give small
+ * numbers: 0, -1, 1, -2, 2 become 0, 1, 2, 3, 4.
+ */
+inline uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/**
+ * Reverses the zigzag mapping.
+ */
+inline int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/**
+ * The frequencies of the bit lengths of the numbers coded with a model,
+ * normalised to add up to the scale. The table is stored in the file before
+ * the coded data.
+ */
+class FrequencyTable {
+ private:
+  uint16_t freq[symbolNum];
+  uint16_t cumulative[symbolNum];
+  uint8_t slotSymbol[scale];  // The symbol of every slot of the scale
+  bool empty;                 // True if no symbol occurs
+
+  /**
+   * Calculates the cumulative frequencies and the symbol lookup table.
+   * Returns false if the frequencies do not add up to the scale.
+   */
+  bool finish() {
+    uint32_t sum = 0;
+    for (int s = 0; s < symbolNum; s++) {
+      cumulative[s] = sum;
+      if (sum + freq[s] > scale) return false;
+      std::fill(slotSymbol + sum, slotSymbol + sum + freq[s], s);
+      sum += freq[s];
+    }
+    empty = sum == 0;
+    return sum == scale || empty;
+  }
+
+ public:
+  FrequencyTable() : empty(true) { std::fill(freq, freq + symbolNum, 0); }
+
+  /**
+   * Sets the frequencies from the number of times each symbol occurs. Every
+   * occurring symbol gets at least one slot.
+   */
+  void build(const uint32_t* counts) {
+    uint64_t total = 0;
+    int largest = 0;
+    for (int s = 0; s < symbolNum; s++) {
+      total += counts[s];
+      if (counts[s] > counts[largest]) largest = s;
+    }
+    int32_t sum = 0;
+    for (int s = 0; s < symbolNum; s++) {
+      freq[s] = 0;
+      if (counts[s] > 0)
+        freq[s] = std::max<uint64_t>(1, counts[s] * scale / total);
+      sum += freq[s];
+    }
+    // The largest symbol absorbs the rounding error
+    if (total > 0) freq[largest] += scale - sum;
+    finish();
+  }
+
+  /**
+   * Appends the table to the buffer: the number of symbols up to the last
+   * occurring one, then their frequencies.
+   */
+  void write(std::string& out) const {
+    int used = symbolNum;
+    while (used > 0 && freq[used - 1] == 0) used--;
+    out.push_back((char)used);
+    for (int s = 0; s < used; s++) {
+      out.push_back((char)(freq[s] & 0xff));
+      out.push_back((char)(freq[s] >> 8));
+    }
+  }
+
+  /**
+   * Reads a table written by write and moves p past it. Returns false if the
+   * table is invalid or does not fit before the end.
+   */
+  bool read(const char*& p, const char* end) {
+    if (p >= end) return false;
+    int used = (uint8_t)*p++;
+    if (used > symbolNum || end - p < 2 * used) return false;
+    std::fill(freq, freq + symbolNum, 0);
+    for (int s = 0; s < used; s++, p += 2)
+      freq[s] = (uint8_t)p[0] | ((uint8_t)p[1] << 8);
+    return finish();
+  }
+
+  bool isEmpty() const { return empty; }
+
+  friend class Encoder;
+  friend class Decoder;
+};
+
+/**
+ * Codes symbols into 16 bit words. rANS works like a stack, so the symbols
+ * have to be put in reverse order, and the words are reversed at the end so
+ * that the decoder can read them forwards.
+ */
+class Encoder {
+ private:
+  std::vector<uint16_t> words;
+  uint32_t state;
+
+ public:
+  Encoder() : state(lowerBound) {}
+
+  /**
+   * Codes the symbol with the given table.
+   */
+  void put(const FrequencyTable& table, int symbol) {
+    uint32_t freq = table.freq[symbol];
+    uint64_t max = (uint64_t)((lowerBound >> scaleBits) << 16) * freq;
+    while (state >= max) {
+      words.push_back(state & 0xffff);
+      state >>= 16;
+    }
+    state = ((state / freq) << scaleBits) + (state % freq) +
+            table.cumulative[symbol];
+  }
+
+  /**
+   * Appends the coded words to the buffer in little-endian byte order.
+   */
+  void finish(std::string& out) {
+    words.push_back(state & 0xffff);
+    words.push_back(state >> 16);
+    for (auto it = words.rbegin(); it != words.rend(); it++) {
+      out.push_back((char)(*it & 0xff));
+      out.push_back((char)(*it >> 8));
+    }
+  }
+};
+
+/**
+ * Decodes the symbols coded by the encoder, in the original order. Reading
+ * past the end of the buffer gives zero words instead of failing.
+ */
+class Decoder {
+ private:
+  const uint8_t* p;
+  const uint8_t* end;
+  uint32_t state;
+
+  /**
+   * Returns the next word of the input.
+   */
+  uint32_t next() {
+    if (end - p < 2) return 0;
+    uint32_t word = p[0] | (p[1] << 8);
+    p += 2;
+    return word;
+  }
+
+ public:
+  Decoder(const char* begin, const char* end_)
+      : p((const uint8_t*)begin), end((const uint8_t*)end_) {
+    state = next() << 16;
+    state |= next();
+  }
+
+  /**
+   * Decodes the next symbol with the table it was coded with.
+   */
+  int get(const FrequencyTable& table) {
+    uint32_t slot = state & (scale - 1);
+    int symbol = table.slotSymbol[slot];
+    state = table.freq[symbol] * (state >> scaleBits) + slot -
+            table.cumulative[symbol];
+    while (state < lowerBound) state = (state << 16) | next();
+    return symbol;
+  }
+};
+
+/**
+ * Writes bits into a plain stream, the first bit at the bottom of the first
+ * byte.
+ */
+class BitWriter {
+ private:
+  std::string& out;
+  uint64_t buffer;  // The bits not written yet, the oldest at the bottom
+  int count;
+
+ public:
+  BitWriter(std::string& out_) : out(out_), buffer(0), count(0) {}
+
+  /**
+   * Writes the lowest bits of the value, at most 32.
+   */
+  void write(uint32_t value, int bits) {
+    if (bits == 0) return;
+    buffer |= (uint64_t)(value & (0xffffffffu >> (32 - bits))) << count;
+    count += bits;
+    while (count >= 8) {
+      out.push_back((char)(buffer & 0xff));
+      buffer >>= 8;
+      count -= 8;
+    }
+  }
+
+  /**
+   * Writes out the last partial byte, must be called after the last bit.
+   */
+  void flush() {
+    if (count > 0) out.push_back((char)(buffer & 0xff));
+    buffer = 0;
+    count = 0;
+  }
+};
+
+/**
+ * Reads the bits written by the bit writer. Reading past the end of the
+ * buffer gives zero bits.
+ */
+class BitReader {
+ private:
+  const uint8_t* p;
+  const uint8_t* end;
+  uint64_t buffer;
+  int count;
+
+ public:
+  BitReader(const char* begin, const char* end_)
+      : p((const uint8_t*)begin), end((const uint8_t*)end_), buffer(0),
+        count(0) {}
+
+  /**
+   * Reads the given number of bits, at most 32.
+   */
+  uint32_t read(int bits) {
+    if (bits == 0) return 0;
+    while (count < bits) {
+      buffer |= (uint64_t)(p < end ? *p++ : 0) << count;
+      count += 8;
+    }
+    uint32_t value = buffer & (0xffffffffu >> (32 - bits));
+    buffer >>= bits;
+    count -= bits;
+    return value;
+  }
+};
+}  // namespace EntropyCoder
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_FRAME_RECORDER_H_
+#define _PHY3D_FRAME_RECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * A timed zone recorded by the frame recorder.
+ */
+struct TraceEvent {
+  const char* name;  // Has to be a string literal, only the pointer is stored
+  uint64_t start;    // Start time in nanoseconds
+  uint64_t duration;
+  uint32_t frame;  // The frame the zone belongs to
+};
+
+/**
+ * Flight recorder that keeps the timed zones of the last few frames in a fixed
+ * size ring buffer per thread. Writing a zone never locks or allocates, and
+ * when the recorder is disabled a zone costs a single branch. The recorded
+ * frames can be dumped as a Chrome trace JSON file (also readable by
+ * Perfetto), either on request or automatically after a slow frame.
+ */
+class FrameRecorder {
+ private:
+  static std::atomic<bool> enabled;
+  static std::atomic<uint32_t> frame;
+  static uint64_t frameStart;
+  static uint64_t hitchThreshold;  // Frame time triggering a dump, 0 is off
+  static uint32_t lastAutoDump;
+  static int autoDumps;  // The hitch dumps written so far
+  static std::string hitchPrefix;
+
+ public:
+  static const int ringSize = 8192;   // Events kept per thread
+  static const int dumpFrames = 120;  // Frames written into a dump
+  static const int maxAutoDumps = 10;  // Hitch dumps written at most
+
+  static void setEnabled(bool e) {
+    enabled.store(e, std::memory_order_relaxed);
+  }
+  static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+  static void record(const char* name, uint64_t start, uint64_t end);
+  static void beginFrame();
+  static uint64_t endFrame();
+  static uint32_t getFrame() { return frame.load(std::memory_order_relaxed); }
+  static void setHitchDump(float thresholdMs, const char* prefix = "hitch");
+  static bool dump(const char* fileName, int frames = dumpFrames);
+};
+
+/**
+ * Records the time spent in the enclosing scope into the frame recorder.
+ */
+class ScopedZone {
+ private:
+  const char* name;
+  uint64_t start;
+
+ public:
+  ScopedZone(const char* name_) : name(name_) {
+    start = FrameRecorder::isEnabled() ? FrameRecorder::now() : 0;
+  }
+  ~ScopedZone() {
+    if (start != 0) FrameRecorder::record(name, start, FrameRecorder::now());
+  }
+};
+
+#define TRACE_ZONE_CONCAT2(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT2(a, b)
+// Times the rest of the current scope under the given name
+#define TRACE_ZONE(name) \
+  ScopedZone TRACE_ZONE_CONCAT(traceZone, __LINE__)(name)
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_GOLDEN_TRAJECTORY_H_
+#define _PHY3D_GOLDEN_TRAJECTORY_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BallStore.h"
+#include "Vec3.h"
+
+/**
+ * The state of a ball at a given step of a run.
+ */
+struct GoldenSample {
+  uint32_t step;
+  unsigned int id;
+  Vec3 pos;
+  Vec3 vel;
+};
+
+/**
+ * Ball trajectories sampled every few steps of a run, together with the
+ * median step time of the run. A trajectory stored from a known good build
+ * can be compared against a new run to catch changes of the physics, and its
+ * step time against the new one to catch slowdowns.
+ */
+class GoldenTrajectory {
+ private:
+  std::vector<GoldenSample> samples;  // Ordered by step, then by id
+  double stepMs;  // The median step time of the run
+
+ public:
+  GoldenTrajectory() : stepMs(0) {}
+  void capture(uint32_t step, const BallStore& balls);
+  size_t getSampleCount() const { return samples.size(); }
+  void setStepMs(double ms) { stepMs = ms; }
+  double getStepMs() const { return stepMs; }
+  bool compare(const GoldenTrajectory& golden, float tolerance,
+               std::ostream& report) const;
+  bool save(const char* fileName) const;
+  bool load(const char* fileName);
+};
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_HEATMAP_OVERLAY_H_
+#define _PHY3D_HEATMAP_OVERLAY_H_
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengles2.h>
+
+#include <cmath>
+#include <vector>
+
+#include "CollisionHeatmap.h"
+#include "Model.h"
+
+/**
+ * Renders the world colored by the collision heatmap. The triangles are sorted
+ * into a few cost levels on a logarithmic scale, every level has its own index
+ * buffer drawn with the vertex buffer of the world, so the whole overlay is a
+ * handful of draw calls and the shaders do not need per-vertex colors.
+ */
+class HeatmapOverlay {
+ private:
+  static const int levels = 8;  // Level 0 holds the untested triangles
+  GLuint elementBufferObjs[levels];
+  GLsizei indexCounts[levels];
+  int64_t gpuBytes;  // The size of the index buffers
+  bool visible;
+
+ public:
+  HeatmapOverlay();
+  ~HeatmapOverlay();
+  HeatmapOverlay(const HeatmapOverlay&) = delete;
+  HeatmapOverlay& operator=(const HeatmapOverlay&) = delete;
+  void toggle() { visible = !visible; }
+  bool isVisible() const { return visible; }
+  void update(const Mesh& world, const CollisionHeatmap& heatmap);
+  void render(const Model& world, GLint posAttrib, GLint colorLocation) const;
+};
+
+#endif
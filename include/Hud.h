@@ -0,0 +1,79 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_HUD_H_
+#define _PHY3D_HUD_H_
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengles2.h>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Matrix.h"
+
+/**
+ * The numbers shown on the performance overlay.
+ */
+struct HudStats {
+  float frameMs;        // The length of the last frame
+  float stepMs;         // The time spent in the last physics step
+  int balls;            // The number of balls in the scene
+  int awakeBalls;       // The number of moving balls
+  long pairTests;       // Ball pairs tested in the broadphase
+  long triangleTests;   // Vertices and triangles tested in the narrowphase
+  long cacheRebuilds;   // Ball geometry caches rebuilt from the whole world
+  int contacts;         // Contacts found
+  int resolved;         // Contacts that needed a response
+  unsigned long drawCalls;  // glDrawElements calls of the last frame
+  float swapMs;             // Presenting the last frame (waiting for vsync)
+  float inputMs;            // Latency of the last input, 0 if none
+  float inputP50Ms, inputP99Ms;  // Input latency percentiles of the session
+  float memoryMb, memoryPeakMb;  // Accounted memory of the subsystems
+  float loadPercent;  // Progress of the scene being loaded, negative if none
+};
+
+/**
+ * Toggleable overlay showing performance counters and rolling graphs of the
+ * frame and step times. Everything is drawn as lines with the scene's shader,
+ * the text uses a built-in segment font so no textures are needed.
+ */
+class Hud {
+ private:
+  static const int historySize = 180;  // Samples shown on the graphs
+
+  GLuint vertexBufferObj;
+  std::vector<GLfloat> lines;  // Vertex pairs of the lines of the overlay
+  float frameHistory[historySize];
+  float stepHistory[historySize];
+  int historyPos;
+  bool visible;
+
+  void addLine(float x1, float y1, float x2, float y2);
+  void addText(float x, float y, float size, const char* str);
+  void addGraph(float x, float y, float w, float h, const float* samples,
+                float maxValue);
+  void drawLines(GLint posAttrib, GLint colorLocation, size_t from,
+                 float r, float g, float b);
+
+ public:
+  Hud();
+  ~Hud();
+  Hud(const Hud&) = delete;
+  Hud& operator=(const Hud&) = delete;
+  void toggle() { visible = !visible; }
+  bool isVisible() const { return visible; }
+  void addSample(float frameMs, float stepMs);
+  void render(GLint posAttrib, GLint colorLocation, GLint projectionLocation,
+              GLint modelViewLocation, int width, int height,
+              const HudStats& stats);
+};
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_INPUT_RECORDING_H_
+#define _PHY3D_INPUT_RECORDING_H_
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Ball.h"
+#include "BallEmitter.h"
+#include "Mesh.h"
+#include "Simulation.h"
+#include "StateSnapshot.h"
+#include "Vec3.h"
+
+enum InputEventType {
+  CAMERA_INPUT,          // The camera moved: pos and vel (as direction)
+  PLACE_BALL_INPUT,      // A ball was shot: pos, vel and the ball settings
+  CLEAR_BALLS_INPUT,     // Every ball was removed
+  TIME_STOP_INPUT,       // The time was stopped (flag) or restarted
+  EMITTER_START_INPUT,   // An emitter was started, see makeEmitter
+  EMITTER_STOP_INPUT,    // The active emitter was stopped
+  EMITTER_STREAM_INPUT,  // The stream of the emitter moved: pos and vel
+  LOAD_SCENE_INPUT,      // A scene file was loaded from path
+  INPUT_EVENT_TYPES
+};
+
+/**
+ * A user action that changes the simulation, with every parameter needed to
+ * repeat it exactly without the window, the camera or the clock.
+ */
+struct InputEvent {
+  uint32_t frame;  // The frame the action happened in
+  InputEventType type;
+  Vec3 pos;
+  Vec3 vel;
+  float radius, bounciness, friction;  // Settings of the (prototype) ball
+  EmitterPattern pattern;
+  int32_t count;
+  float rate;
+  Vec3 boxMin, boxMax;
+  uint32_t seed;
+  bool flag;
+  std::string path;
+
+  InputEvent(InputEventType type_ = CLEAR_BALLS_INPUT, uint32_t frame_ = 0);
+  void setBall(const Ball& b);
+  Ball makeBall() const;
+  BallEmitter makeEmitter() const;
+};
+
+/**
+ * The input stream of a session, stored in a compact binary file together
+ * with the exact state the session was in when the recording started: the
+ * world geometry and a snapshot of the simulation. Replaying the events with
+ * the fixed time step of the recording repeats the session exactly, so
+ * recorded sessions can be used as repeatable benchmarks. The snapshot is
+ * stored as it is in memory, so like checkpoints, recordings can only be
+ * replayed by builds of the same platform.
+ */
+class InputRecording {
+ private:
+  float dt;              // The fixed time step of a frame
+  uint32_t frameCount;   // The length of the recording in frames
+  bool startStopped;     // Whether the time was stopped at the start
+  Mesh startWorld;       // The world geometry the recording starts from
+  StateSnapshot startState;  // The state of the simulation at the start
+  std::vector<InputEvent> events;  // In the order of their frames
+  size_t cursor;         // The next event to replay
+
+  static void copyMesh(const Mesh& from, Mesh& to);
+
+ public:
+  static constexpr uint32_t version = 2;
+
+  InputRecording();
+  InputRecording(const InputRecording&) = delete;
+  InputRecording& operator=(const InputRecording&) = delete;
+  void start(const Simulation& sim, float dt_, bool stopped);
+  void restore(Simulation& sim) const;
+  void add(const InputEvent& e) { events.push_back(e); }
+  void finish(uint32_t frames) { frameCount = frames; }
+  float getDt() const { return dt; }
+  uint32_t getFrameCount() const { return frameCount; }
+  bool isStartStopped() const { return startStopped; }
+  size_t getEventCount() const { return events.size(); }
+  void rewind() { cursor = 0; }
+  const InputEvent* next(uint32_t frame);
+  bool save(const char* fileName) const;
+  bool load(const char* fileName);
+};
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_KILL_VOLUME_H_
+#define _PHY3D_KILL_VOLUME_H_
+
+#include <cmath>
+
+#include "Vec3.h"
+
+/**
+ * Axis aligned box, the balls entering it are removed from the scene.
+ */
+struct KillVolume {
+  Vec3 min;
+  Vec3 max;
+
+  KillVolume() {}
+  // The two opposite corners of the box can be given in any order
+  KillVolume(const Vec3& a, const Vec3& b)
+      : min(std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z)),
+        max(std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z)) {}
+
+  bool contains(const Vec3& p) const {
+    return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y &&
+           p.z >= min.z && p.z <= max.z;
+  }
+};
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_LATENCY_HISTOGRAM_H_
+#define _PHY3D_LATENCY_HISTOGRAM_H_
+
+#include <cstdint>
+#include <iostream>
+
+/**
+ * Histogram of durations with log-linear buckets in the style of HdrHistogram:
+ * every power of two range is split into the same number of equal buckets, so
+ * the relative error of the percentiles stays below 1/subBuckets from a
+ * nanosecond up to several minutes, while the memory use is fixed.
+ */
+class LatencyHistogram {
+ private:
+  static const int subBucketBits = 5;  // 32 buckets per power of two
+  static const int subBuckets = 1 << subBucketBits;
+  static const int ranges = 64 - subBucketBits + 1;
+  static const int bucketCount = ranges * subBuckets;
+
+  uint64_t counts[bucketCount];
+  uint64_t count;
+  uint64_t minValue;
+  uint64_t maxValue;
+  double sum;
+
+  static int bucketOf(uint64_t value);
+  static uint64_t bucketMidpoint(int bucket);
+
+ public:
+  LatencyHistogram();
+  void record(uint64_t value);
+  void reset();
+  uint64_t getCount() const { return count; }
+  uint64_t getMin() const { return count > 0 ? minValue : 0; }
+  uint64_t getMax() const { return maxValue; }
+  double getMean() const { return count > 0 ? sum / count : 0; }
+  uint64_t getPercentile(double percentile) const;
+  void writeSummary(std::ostream& os, double unit = 1e6) const;
+};
+
+#endif
@@ -0,0 +1,37 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_MAPPEDFILE_H_
+#define _PHY3D_MAPPEDFILE_H_
+
+#include <cstddef>
+
+/**
+ * A whole file mapped into memory. The mapping is private, so the contents
+ * can be modified in place without changing the file. Where memory mapping
+ * is not available, the file is read into an allocated buffer instead.
+ */
+class MappedFile {
+ private:
+  char* data;
+  size_t size;
+  bool mapped;  // False if the data was read into a buffer
+
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  bool open(const char* fileName);
+  void close();
+  char* getData() { return data; }
+  const char* getData() const { return data; }
+  size_t getSize() const { return size; }
+};
+
+#endif
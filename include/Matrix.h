@@ -42,6 +42,8 @@ class Matrix {
                         float zNear, float zFar);
   static Matrix perspective(float fov, float aspectRatio, float zNear,
                             float zFar);
+  static Matrix orthographic(float left, float right, float bottom, float top,
+                             float zNear, float zFar);
 };
 
 #endif
@@ -0,0 +1,63 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_MEMORY_STATS_H_
+#define _PHY3D_MEMORY_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+enum MemoryCategory {
+  MESH_MEMORY,        // Vertices and indices of the meshes on the CPU
+  GPU_BUFFER_MEMORY,  // Vertex and index buffers uploaded to OpenGL
+  BALL_MEMORY,        // The ball store and its id tables
+  BALL_CACHE_MEMORY,  // The nearby geometry cached by the balls
+  CONTACT_MEMORY,     // The contact arena of the physics step
+  HEATMAP_MEMORY,     // The per-triangle counters of the collision heatmap
+  SAVE_MEMORY,        // Scene snapshots and text kept for saving
+  STATE_MEMORY,       // Dynamic state snapshots kept for rewinding
+  SCENE_CACHE_MEMORY,  // Recently loaded scenes kept for switching back
+  MEMORY_CATEGORY_COUNT
+};
+
+/**
+ * Accounts the bytes held by each subsystem, along with the peak values. The
+ * owners report their allocations, so the numbers are the sizes of the
+ * arrays and buffers rather than what the allocator uses, which is what
+ * decides whether a scene fits into a memory budget. Updating a counter is a
+ * couple of relaxed atomic operations.
+ */
+class MemoryStats {
+ private:
+  static std::atomic<int64_t> current[MEMORY_CATEGORY_COUNT];
+  static std::atomic<int64_t> peak[MEMORY_CATEGORY_COUNT];
+  static std::atomic<int64_t> total;
+  static std::atomic<int64_t> totalPeak;
+
+  static void raisePeak(std::atomic<int64_t>& p, int64_t value);
+
+ public:
+  static void add(MemoryCategory c, int64_t bytes);
+  static void set(MemoryCategory c, int64_t bytes);
+  static int64_t getCurrent(MemoryCategory c) {
+    return current[c].load(std::memory_order_relaxed);
+  }
+  static int64_t getPeak(MemoryCategory c) {
+    return peak[c].load(std::memory_order_relaxed);
+  }
+  static int64_t getTotal() { return total.load(std::memory_order_relaxed); }
+  static int64_t getTotalPeak() {
+    return totalPeak.load(std::memory_order_relaxed);
+  }
+  static const char* getName(MemoryCategory c);
+  static void resetPeaks();
+  static void print(std::ostream& os);
+};
+
+#endif
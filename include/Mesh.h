@@ -0,0 +1,66 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_MESH_H_
+#define _PHY3D_MESH_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "MappedFile.h"
+#include "MemoryStats.h"
+#include "Vec3.h"
+
+/**
+ * Triangle mesh stored in CPU memory. It has no OpenGL dependency, so it can
+ * be used for collision detection without a window.
+ */
+class Mesh {
+ protected:
+  float* vertices;
+  unsigned int vCount;
+  unsigned int* indices;
+  unsigned int iCount;
+  int64_t accountedBytes;  // The size of the arrays reported to MemoryStats
+  MappedFile* mapping;  // The baked file holding the arrays, if they are in one
+  uint64_t revision;    // Changes whenever the geometry is replaced
+
+  void setAccountedBytes(int64_t bytes);
+  void touch();
+
+ public:
+  Mesh();
+  virtual ~Mesh();
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+  unsigned int getVertexNum() const;
+  Vec3 getVertex(unsigned int index) const;
+  unsigned int getTriangleNum() const;
+  void getTriangle(unsigned int index, Vec3* a, Vec3* b, Vec3* c) const;
+  void getTriangleIdx(unsigned int index, unsigned int* a, unsigned int* b,
+                      unsigned int* c) const;
+  bool getBounds(Vec3* min, Vec3* max) const;
+  uint64_t getRevision() const { return revision; }
+  void releaseArrays();
+  void swap(Mesh& other);
+  friend std::istream& operator>>(std::istream& is, Mesh& mesh);
+  friend class BakedScene;
+  friend class CompressedScene;
+  friend class InputRecording;
+  friend class MeshPatch;
+  friend class SceneCache;
+  friend class SceneParser;
+  friend class SceneWriter;
+  friend class WorldStreamer;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_MESHPATCH_H_
+#define _PHY3D_MESHPATCH_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+#include "Vec3.h"
+
+/**
+ * A range of elements of a vertex or an index array.
+ */
+struct MeshRange {
+  unsigned int first;
+  unsigned int count;
+};
+
+/**
+ * The difference between a loaded mesh and a new version of it, for hot
+ * reloading edited scenes. It holds the ranges of the vertex and index
+ * arrays that changed, and the box containing every changed triangle in
+ * both versions, so only the GPU buffers and the ball geometry caches in it
+ * have to be updated. Ranges closer than mergeGap elements are merged, so a
+ * scattered edit does not turn into thousands of tiny uploads.
+ */
+class MeshPatch {
+ private:
+  std::vector<MeshRange> vertexRanges;  // In floats of the vertex array
+  std::vector<MeshRange> indexRanges;   // In elements of the index array
+  bool vertexResized;
+  bool indexResized;
+  bool changed;
+  bool bounded;   // Whether a triangle changed
+  Vec3 min, max;  // The box of the changed triangles, if bounded
+
+  void extend(const Vec3& v);
+  void addTriangles(const Mesh& mesh, const std::vector<bool>& movedVertices,
+                    const std::vector<MeshRange>& ranges,
+                    unsigned int commonIndices);
+
+ public:
+  static const unsigned int mergeGap = 256;
+
+  MeshPatch();
+  void compute(const Mesh& current, const Mesh& next);
+  void apply(Mesh& current, Mesh& next) const;
+  bool isEmpty() const { return !changed; }
+  bool isVertexResized() const { return vertexResized; }
+  bool isIndexResized() const { return indexResized; }
+  const std::vector<MeshRange>& getVertexRanges() const {
+    return vertexRanges;
+  }
+  const std::vector<MeshRange>& getIndexRanges() const { return indexRanges; }
+  bool getBounds(Vec3* min_, Vec3* max_) const;
+  size_t getChangedBytes() const;
+};
+
+#endif
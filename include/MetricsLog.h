@@ -0,0 +1,88 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_METRICS_LOG_H_
+#define _PHY3D_METRICS_LOG_H_
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#include "LatencyHistogram.h"
+#include "Simulation.h"
+
+/**
+ * The measurements of a single frame.
+ */
+struct FrameMetrics {
+  uint32_t frame;
+  uint64_t frameNs;   // The whole frame, including waiting for vsync
+  uint64_t stepNs;    // The physics step, 0 if the time was stopped
+  uint64_t renderNs;  // Issuing the draw calls
+  uint64_t swapNs;    // Presenting the frame, mostly waiting for vsync
+  uint64_t inputLatencyNs;  // Oldest input to presentation, 0 if no input
+  uint64_t inputWaitNs;     // Oldest input to the start of the frame
+  int balls;
+  StepStats step;  // Counters and phase times of the physics step
+};
+
+/**
+ * Writes the metrics of every frame into a JSON-lines file for soak tests and
+ * keeps histograms of the frame and step times. Formatting and writing is done
+ * on a background thread in batches, so a frame only pays for appending its
+ * record to a buffer. The browser build has no threads, there the batches are
+ * written on the calling thread instead. Closing the log appends a summary
+ * line with the percentiles of the whole run.
+ */
+class MetricsLog {
+ private:
+  static const int batchSize = 256;  // Records handed to the writer at once
+
+  std::ofstream file;
+  std::vector<FrameMetrics> pending;  // Filled by the frames
+  LatencyHistogram frameTimes;
+  LatencyHistogram stepTimes;
+  LatencyHistogram swapTimes;
+  LatencyHistogram inputLatencies;
+  LatencyHistogram phaseTimes[STEP_PHASE_COUNT];
+
+#ifndef __EMSCRIPTEN__
+  std::vector<FrameMetrics> writing;  // Owned by the writer thread
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  bool batchReady;
+  bool stopping;
+
+  void writerLoop();
+#endif
+
+  void writeBatch(const std::vector<FrameMetrics>& batch);
+  void flushPending();
+
+ public:
+  MetricsLog();
+  ~MetricsLog();
+  MetricsLog(const MetricsLog&) = delete;
+  MetricsLog& operator=(const MetricsLog&) = delete;
+  bool open(const char* fileName);
+  bool isOpen() const { return file.is_open(); }
+  void record(const FrameMetrics& m);
+  void close();
+  const LatencyHistogram& getFrameTimes() const { return frameTimes; }
+  const LatencyHistogram& getStepTimes() const { return stepTimes; }
+  const LatencyHistogram& getInputLatencies() const { return inputLatencies; }
+};
+
+#endif
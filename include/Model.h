@@ -18,32 +18,37 @@
 #include <sstream>
 #include <string>
 
+#include "Mesh.h"
+#include "MeshPatch.h"
 #include "Vec3.h"
 
-class Model {
- protected:
-  GLfloat* vertices;
-  GLuint vCount;
-  GLuint* indices;
-  GLuint iCount;
-
+/**
+ * A mesh that can also be rendered with OpenGL.
+ */
+class Model : public Mesh {
  private:
   GLuint vertexBufferObj;
   GLuint elementBufferObj;
+  mutable int64_t gpuBytes;  // The size of the buffers uploaded to OpenGL
+
+ protected:
+  static unsigned long drawCalls;  // glDrawElements calls since the last reset
 
  public:
   Model();
   ~Model();
   virtual void loadModel();
   void loadToGL() const;
+  size_t getGLBytes() const;
+  size_t uploadToGL(size_t offset, size_t maxBytes) const;
+  size_t uploadPatch(const MeshPatch& patch) const;
+  void swap(Model& other);
   void bindBuffers() const;
   void render(GLint posAttrib, GLenum mode = GL_TRIANGLES) const;
   void renderOneByOne(GLint posAttrib, GLenum mode = GL_TRIANGLES) const;
-  GLuint getVertexNum() const;
-  Vec3 getVertex(GLuint index) const;
-  GLuint getTriangleNum() const;
-  void getTriangle(GLuint index, Vec3* a, Vec3* b, Vec3* c) const;
-  void getTriangleIdx(GLuint index, GLuint* a, GLuint* b, GLuint* c) const;
+  static unsigned long getDrawCalls() { return drawCalls; }
+  static void resetDrawCalls() { drawCalls = 0; }
+  static void addDrawCalls(unsigned long n) { drawCalls += n; }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,53 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_MORTON_H_
+#define _PHY3D_MORTON_H_
+
+#include <cstdint>
+
+#include "Vec3.h"
+
+namespace Morton {
+/**
+ * Spreads the lower 10 bits of the given number so that there are two zero
+ * bits between each of them.
+ */
+inline uint32_t spreadBits(uint32_t v) {
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+/**
+ * Quantizes a coordinate into the [0, 1023] range given the lower bound and
+ * the scale of the grid.
+ */
+inline uint32_t quantize(float v, float min, float scale) {
+  float q = (v - min) * scale;
+  if (!(q > 0.0f)) return 0;
+  if (q > 1023.0f) return 1023;
+  return (uint32_t)q;
+}
+
+/**
+ * Returns the 30 bit Morton code (Z-order curve index) of the given point
+ * inside the box starting at min with the given number of cells per unit.
+ * Points that are close in space tend to have close codes.
+ */
+inline uint32_t encode(const Vec3& p, const Vec3& min, float scale) {
+  return (spreadBits(quantize(p.x, min.x, scale)) << 2) |
+         (spreadBits(quantize(p.y, min.y, scale)) << 1) |
+         spreadBits(quantize(p.z, min.z, scale));
+}
+}  // namespace Morton
+
+#endif
@@ -22,15 +22,32 @@
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "BakedScene.h"
 #include "Ball.h"
+#include "BallEmitter.h"
+#include "BallStore.h"
 #include "Camera.h"
+#include "CompressedScene.h"
+#include "FrameRecorder.h"
+#include "HeatmapOverlay.h"
+#include "Hud.h"
+#include "InputRecording.h"
+#include "KillVolume.h"
 #include "Matrix.h"
+#include "MetricsLog.h"
 #include "Model.h"
 #include "ObjModel.h"
 #include "Shaders.h"
+#include "SceneLoader.h"
+#include "SceneWriter.h"
+#include "StateSnapshot.h"
+#include "Simulation.h"
 #include "SphereModel.h"
 #include "Vec3.h"
+#include "WorldStreamer.h"
 
 class Scene3D {
  private:
@@ -59,8 +76,49 @@ class Scene3D {
   Camera cam;
   SphereModel content;
   ObjModel world;
-  Ball* balls;
-  int ballCount;
+  ObjModel loadingWorld;  // The next world, loaded in the background
+  SceneCache sceneCache;  // Recently loaded scenes, for switching back
+  SceneLoader loader;
+  bool uploadingWorld;    // The loaded world is being uploaded to the GPU
+  size_t uploadedBytes;   // The part of the loaded world already uploaded
+  static const size_t uploadBytesPerFrame = 256 * 1024;
+  bool slicedLoading;  // Load scenes in time slices instead of on a thread
+  static const uint64_t loadBudgetNs = 4000000;  // Loading per frame
+  WorldStreamer streamer;  // Loads the tiles of very large scenes on demand
+  std::vector<Model*> tileModels;  // The resident tiles to render, by tile
+  std::string scenePath;  // The file the current world was loaded from
+  bool watchingScene;     // Reload the scene when its file changes
+  bool reloadingScene;    // The loader is reading the changed scene file
+  SceneKey watchedKey;    // The version of the file the world is from
+  uint64_t lastWatchNs;   // The last check of the scene file
+  static const uint64_t watchIntervalNs = 250000000;
+  SceneWriter writer;       // Saves the scene on a background thread
+  uint64_t autosaveNs;      // The time between autosaves, 0 if disabled
+  uint64_t lastAutosaveNs;  // The start of the last autosave
+  Simulation sim;  // The balls and the physics, colliding with the world
+  SnapshotRing rewindRing;  // Recent states of the simulation, for rewinding
+  int framesSinceSnapshot;
+  static const int snapshotInterval = 30;  // Frames between the snapshots
+  static const int rewindSnapshots = 120;  // A minute at 60 fps
+  BallEmitter emitter;  // Spawns balls in bulk, see startEmitter
+  bool emitterActive;
+  Hud hud;             // Performance overlay, toggled with H
+  HeatmapOverlay heatmapOverlay;  // Collision costs of the world, C toggles
+  uint64_t lastFrameNs;   // The length of the previous frame
+  uint64_t lastStepNs;    // The last physics step, 0 while time is stopped
+  uint64_t lastRenderNs;  // Issuing the draw calls of the last frame
+  MetricsLog metrics;     // Per-frame metrics, only written if opened
+  uint64_t oldestInputNs;  // The oldest input handled in this frame, or 0
+  uint64_t lastInputLatencyNs;  // Oldest input to presentation, or 0
+  uint64_t lastInputWaitNs;     // Oldest input to the start of the frame
+  uint64_t lastSwapNs;          // Presenting the frame, waiting for vsync
+  LatencyHistogram inputLatencies;  // Input latencies of the session
+  bool finishBeforeTiming;  // Wait for the GPU before timing the presentation
+  InputRecording inputRecording;  // The recorded or replayed input
+  bool recordingInput;
+  bool replayingInput;
+  uint32_t inputFrame;  // Frames since the recording or the replay started
+  Vec3 lastCamPos, lastCamDir;  // The camera stored in the last camera event
 
   bool WASDKeys[4];
   bool spaceKey;
@@ -79,15 +137,53 @@ class Scene3D {
   static void getBrowserDimensions(int* width, int* height);
 #endif
 
+  Ball makeBall(const Vec3& pos, const Vec3& vel) const;
   void placeBall();
   void addBall(const Ball& b);
   void clearBalls();
+  void startEmitter(EmitterPattern pattern, int count, float ballsPerSecond);
+  void loadScene(const char* fileName);
+  void sceneLoaded();
+  void reportMemory();
+  float getLoadPercent() const;
+  void startLoading(const char* fileName);
+  void updateLoading();
+  void sceneSourceChanged(const std::string& fileName);
+  void updateWatching();
+  void applyReload();
+  bool openStreamed(const char* fileName);
+  void closeStreamed();
+  void updateStreaming();
+  void updateSaving();
+  void rewind();
+  void saveState(const char* fileName) const;
+  void loadState(const char* fileName);
+  void userInput(const InputEvent& e);
+  void recordInput(InputEvent e);
+  void applyInput(InputEvent e);
+  void startRecording();
+  void stopRecording(const char* fileName);
 
  public:
   Scene3D(char const* titleStr = NULL);
   ~Scene3D();
   void enterLoop();
-  void saveScene(const char* fileName) const;
+  void saveScene(const char* fileName);
+  void saveHeatmap(const char* fileName) const;
+  bool openMetrics(const char* fileName) { return metrics.open(fileName); }
+  bool startReplay(const char* fileName);
+  void setFinishBeforeTiming(bool f) { finishBeforeTiming = f; }
+  void setSlicedLoading(bool s) { slicedLoading = s; }
+  void setAutosave(float seconds);
+  void setSceneCacheSize(size_t bytes) { sceneCache.setCapacity(bytes); }
+  void setWatchingScene(bool w) { watchingScene = w; }
+  void setStreamBudget(size_t bytes) { streamer.setBudget(bytes); }
+  Ball* findBall(unsigned int id) { return sim.getBalls().find(id); }
+  void addKillVolume(const KillVolume& v) { sim.addKillVolume(v); }
+  int getContactCount() const { return sim.getContacts().getCount(); }
+  int getContactHighWaterMark() const {
+    return sim.getContacts().getHighWaterMark();
+  }
   friend std::ostream& operator<<(std::ostream& os, const Scene3D& scene);
   friend std::istream& operator>>(std::istream& is, Scene3D& scene);
 };
@@ -0,0 +1,86 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_SCENECACHE_H_
+#define _PHY3D_SCENECACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Ball.h"
+#include "KillVolume.h"
+#include "Mesh.h"
+
+/**
+ * Identifies the contents of a scene file: a file with the same path, size
+ * and modification time is assumed to be unchanged.
+ */
+struct SceneKey {
+  std::string path;
+  uint64_t size;
+  int64_t modified;  // The modification time in the units of the filesystem
+
+  bool operator==(const SceneKey& o) const {
+    return path == o.path && size == o.size && modified == o.modified;
+  }
+};
+
+/**
+ * Keeps the geometry, balls and kill volumes of recently loaded scenes, so
+ * switching back to one of them only copies the arrays instead of reading and
+ * parsing the file again. The least recently used scenes are dropped when
+ * the cache grows over its capacity. It can be used from the loader threads.
+ */
+class SceneCache {
+ private:
+  struct Entry {
+    SceneKey key;
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Ball> balls;
+    std::vector<KillVolume> killVolumes;
+    size_t bytes;
+  };
+
+  std::list<Entry> entries;  // The most recently used first
+  size_t capacity;           // The most bytes kept
+  size_t bytes;              // The bytes of the entries
+  long hits;
+  long misses;
+  mutable std::mutex mutex;
+
+  void evict(size_t limit);
+
+ public:
+#ifdef __EMSCRIPTEN__
+  static const size_t defaultCapacity = 64 << 20;
+#else
+  static const size_t defaultCapacity = 256 << 20;
+#endif
+
+  SceneCache(size_t capacity_ = defaultCapacity);
+  ~SceneCache();
+  SceneCache(const SceneCache&) = delete;
+  SceneCache& operator=(const SceneCache&) = delete;
+  static bool makeKey(const char* fileName, SceneKey& key);
+  bool find(const SceneKey& key, Mesh& mesh, std::vector<Ball>& balls,
+            std::vector<KillVolume>& killVolumes);
+  void store(const SceneKey& key, const Mesh& mesh,
+             const std::vector<Ball>& balls,
+             const std::vector<KillVolume>& killVolumes);
+  void setCapacity(size_t newCapacity);
+  void clear();
+  size_t getBytes() const;
+  long getHits() const;
+  long getMisses() const;
+};
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_SCENELOADER_H_
+#define _PHY3D_SCENELOADER_H_
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Ball.h"
+#include "KillVolume.h"
+#include "Mesh.h"
+#include "SceneCache.h"
+#include "SceneParser.h"
+
+/**
+ * The stages of a text scene loaded in time slices.
+ */
+enum LoadStage {
+  READ_STAGE,   // Reading the file into the buffer
+  COUNT_STAGE,  // Counting the vertices and triangles of the chunks
+  PARSE_STAGE,  // Parsing the chunks into the mesh
+  DONE_STAGE
+};
+
+/**
+ * Loads scene files of any format, either directly or on a background thread
+ * while the current scene keeps running. The geometry is loaded into a mesh
+ * given by the caller, the balls and kill volumes are kept until the caller
+ * activates the new scene.
+ *
+ * Without threads, text scenes can be loaded in time slices instead: every
+ * call of resume reads or parses pieces of the file until the given time is
+ * used up, so a frame loop can load a large file without stalling.
+ */
+class SceneLoader {
+ private:
+  std::thread worker;
+  std::atomic<bool> finished;  // Set by the worker when the load is done
+  bool active;     // A load was started and its end was not reported yet
+  bool succeeded;  // The result of the last load
+  std::string fileName;
+  std::vector<Ball> balls;
+  std::vector<KillVolume> killVolumes;
+  uint64_t startNs;  // When the last load was started
+  uint64_t loadNs;   // How long the last load took
+  Mesh* mesh;        // The mesh being loaded into
+  SceneCache* cache;  // Recently loaded scenes, or NULL
+  bool cacheHit;      // The last scene was found in the cache
+  SceneKey key;       // The key of the file being loaded into the cache
+
+  // The state of a load in time slices
+  bool sliced;
+  LoadStage stage;
+  std::ifstream file;
+  size_t fileSize;
+  std::string buffer;
+  std::vector<ObjChunk> chunks;
+  size_t nextChunk;
+  int slices;  // The number of resume calls of the load
+  static const size_t sliceBytes = 64 * 1024;  // Read or parsed at once
+
+  void run();
+  void finish(bool success);
+  bool advance();
+
+ public:
+  SceneLoader();
+  ~SceneLoader();
+  SceneLoader(const SceneLoader&) = delete;
+  SceneLoader& operator=(const SceneLoader&) = delete;
+  static bool loadFile(const char* fileName, Mesh& mesh,
+                       std::vector<Ball>& balls,
+                       std::vector<KillVolume>& killVolumes,
+                       SceneCache* cache = NULL, bool* cacheHit = NULL);
+  void setCache(SceneCache* c) { cache = c; }
+  void start(const char* fileName, Mesh& mesh, bool inSlices = false);
+  void resume(uint64_t budgetNs);
+  bool poll();
+  bool isLoading() const { return active; }
+  bool hasSucceeded() const { return succeeded; }
+  bool wasCached() const { return cacheHit; }
+  const std::string& getFileName() const { return fileName; }
+  const std::vector<Ball>& getBalls() const { return balls; }
+  const std::vector<KillVolume>& getKillVolumes() const {
+    return killVolumes;
+  }
+  uint64_t getLoadNs() const { return loadNs; }
+  int getSlices() const { return slices; }
+  float getProgress() const;
+};
+
+#endif
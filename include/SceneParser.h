@@ -0,0 +1,61 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_SCENEPARSER_H_
+#define _PHY3D_SCENEPARSER_H_
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "Ball.h"
+#include "KillVolume.h"
+#include "Mesh.h"
+
+/**
+ * A range of whole lines of the obj part of a file, with the number of
+ * vertices and triangles in it and the place of them in the mesh arrays.
+ */
+struct ObjChunk {
+  const char* begin;
+  const char* end;
+  unsigned int vertNum;
+  unsigned int triangleNum;
+  unsigned int vertBase;
+  unsigned int triangleBase;
+};
+
+/**
+ * Fast parser of the scene files. The whole file is read into one buffer, the
+ * lines are found with memchr and the numbers are converted in place, without
+ * creating a string or a stream for every line. A counting pass sizes the
+ * mesh arrays exactly before they are filled, and large files are split into
+ * chunks that are parsed on separate threads. The chunks can also be
+ * processed one by one, which lets a file be parsed over several frames.
+ */
+class SceneParser {
+ public:
+  // Files smaller than this are always parsed on the calling thread
+  static constexpr size_t parallelThreshold = 1 << 20;
+  static constexpr int maxThreads = 8;
+
+  static void readAll(std::istream& is, std::string& buffer);
+  static const char* parseHeader(const char* begin, const char* end,
+                                 std::vector<Ball>& balls,
+                                 std::vector<KillVolume>& killVolumes);
+  static void parseObj(const char* begin, const char* end, Mesh& mesh,
+                       int threads = 0);
+  static std::vector<ObjChunk> splitObj(const char* begin, const char* end,
+                                        int pieces);
+  static void countChunk(ObjChunk& chunk);
+  static void allocate(std::vector<ObjChunk>& chunks, Mesh& mesh);
+  static void parseChunk(const ObjChunk& chunk, Mesh& mesh);
+};
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_SCENEWRITER_H_
+#define _PHY3D_SCENEWRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KillVolume.h"
+#include "Simulation.h"
+#include "Vec3.h"
+
+/**
+ * The attributes of a ball that are stored in a scene file.
+ */
+struct SavedBall {
+  Vec3 pos;
+  float radius;
+  float density;
+  float angularMassMultiplier;
+  float bounciness;
+  float frictionCoefficient;
+
+  /**
+   * Returns the attributes in the order of a #ball line.
+   */
+  void getValues(float values[8]) const {
+    float v[] = {pos.x,      pos.y,      pos.z,
+                 radius,     density,    angularMassMultiplier,
+                 bounciness, frictionCoefficient};
+    for (int i = 0; i < 8; i++) values[i] = v[i];
+  }
+};
+
+/**
+ * Saves text scenes on a background thread. Starting a save only copies the
+ * balls and kill volumes, the text is formatted with to_chars into one buffer
+ * by the worker and written at once. The text of the world geometry is kept
+ * between saves and only formatted again when the world is replaced, so
+ * repeated saves of the same scene do not touch the geometry at all. The
+ * browser build has no threads, there the file is written on the calling
+ * thread instead.
+ */
+class SceneWriter {
+ private:
+  std::thread worker;
+  std::atomic<bool> finished;
+  bool active;     // A save was started and not yet polled
+  bool succeeded;  // The result of the last save
+  std::string fileName;
+  std::vector<SavedBall> balls;
+  std::vector<KillVolume> killVolumes;
+  // A copy of the world, only made when its geometry text is out of date
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+  bool geometryCopied;
+  uint64_t copiedRevision;  // The mesh revision of the copy
+  std::string geometryText;
+  uint64_t textRevision;  // The mesh revision the geometry text is from
+  uint64_t snapshotNs;    // Copying the scene on the calling thread
+  uint64_t writeNs;       // Formatting and writing on the worker
+
+  void run();
+  void account();
+
+ public:
+  SceneWriter();
+  ~SceneWriter();
+  SceneWriter(const SceneWriter&) = delete;
+  SceneWriter& operator=(const SceneWriter&) = delete;
+  bool save(const char* fileName, const Simulation& sim);
+  bool poll();
+  void wait();
+  bool isSaving() const { return active; }
+  bool hasSucceeded() const { return succeeded; }
+  const std::string& getFileName() const { return fileName; }
+  uint64_t getSnapshotNs() const { return snapshotNs; }
+  uint64_t getWriteNs() const { return writeNs; }
+
+  static void collectBalls(const BallStore& store,
+                           std::vector<SavedBall>& out);
+  static void writeScene(std::ostream& os, const Simulation& sim);
+  static void formatHeader(const std::vector<SavedBall>& balls,
+                           const std::vector<KillVolume>& killVolumes,
+                           std::string& out);
+  static void formatGeometry(const float* vertices, size_t vCount,
+                             const unsigned int* indices, size_t iCount,
+                             std::string& out);
+};
+
+#endif
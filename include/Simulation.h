@@ -0,0 +1,117 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_SIMULATION_H_
+#define _PHY3D_SIMULATION_H_
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Ball.h"
+#include "BallStore.h"
+#include "CollisionHeatmap.h"
+#include "ContactArena.h"
+#include "FrameRecorder.h"
+#include "KillVolume.h"
+#include "Mesh.h"
+#include "Vec3.h"
+
+class MeshPatch;
+class SceneCache;
+class WorldStreamer;
+
+/**
+ * The phases of a physics step, timed separately in the step statistics.
+ */
+enum StepPhase {
+  MAINTENANCE_PHASE,  // Morton reordering and retiring lost balls
+  UPDATE_PHASE,
+  BALL_BALL_PHASE,
+  BALL_WORLD_PHASE,
+  RESOLUTION_PHASE,
+  STEP_PHASE_COUNT
+};
+
+extern const char* const stepPhaseNames[STEP_PHASE_COUNT];
+
+/**
+ * Counters describing the work done in a single physics step.
+ */
+struct StepStats {
+  long ballBallTests;   // The number of ball pairs tested for overlap
+  long ballWorldTests;  // The number of vertices and triangles tested
+  int cacheRebuilds;    // The number of ball geometry caches rebuilt
+  long rebuildScans;    // The vertices and triangles scanned by the rebuilds
+  int contacts;         // The number of contacts found
+  int resolved;         // The number of contacts that needed a response
+  int awakeBalls;       // The number of balls still moving after the step
+  uint64_t phaseNs[STEP_PHASE_COUNT];  // Time spent in each phase
+};
+
+/**
+ * The physics of a scene: the balls, the static world geometry they collide
+ * with and the step loop advancing them. It does not depend on SDL or OpenGL,
+ * so scenes can be simulated without a window.
+ */
+class Simulation {
+ private:
+  Mesh* world;  // The static geometry, owned by the creator of the simulation
+  BallStore balls;
+  ContactArena contacts;  // Contacts found in the current physics step
+  Vec3 gravity;
+  int stepsSinceReorder;
+  uint64_t stepCount;  // Steps since the scene was set
+  static const int reorderInterval = 120;  // Steps between Morton sorts
+  std::vector<KillVolume> killVolumes;  // Boxes that remove the balls in them
+  KillVolume worldBounds;  // Balls leaving this box are removed as well
+  bool hasWorldBounds;
+  static constexpr float worldBoundsMargin = 100.0f;
+  static constexpr float awakeSpeed = 1.0f;  // Slower balls count as resting
+  StepStats stats;  // Counters of the last step
+  CollisionHeatmap heatmap;  // Per-triangle costs, only counted if enabled
+  bool heatmapEnabled;
+
+ public:
+  Simulation(Mesh* world_);
+  void step(float dt);
+  int retireLostBalls();
+  void updateWorldBounds();
+  void setWorldBounds(const Vec3& min, const Vec3& max);
+  int worldChanged(const MeshPatch& patch);
+  int tilesChanged(const WorldStreamer& streamer);
+  Mesh& getWorld() { return *world; }
+  const Mesh& getWorld() const { return *world; }
+  BallStore& getBalls() { return balls; }
+  const BallStore& getBalls() const { return balls; }
+  void addBall(const Ball& b) { balls.add(b); }
+  void clearBalls() { balls.clear(); }
+  void addKillVolume(const KillVolume& v) { killVolumes.push_back(v); }
+  void clearKillVolumes() { killVolumes.clear(); }
+  const std::vector<KillVolume>& getKillVolumes() const { return killVolumes; }
+  void setGravity(const Vec3& g) { gravity = g; }
+  Vec3 getGravity() const { return gravity; }
+  const ContactArena& getContacts() const { return contacts; }
+  const StepStats& getStats() const { return stats; }
+  uint64_t getStepCount() const { return stepCount; }
+  void setHeatmapEnabled(bool e) { heatmapEnabled = e; }
+  bool isHeatmapEnabled() const { return heatmapEnabled; }
+  const CollisionHeatmap& getHeatmap() const { return heatmap; }
+  void resetHeatmap() { heatmap.reset(world->getTriangleNum()); }
+  bool load(const char* fileName, SceneCache* cache = NULL);
+  void setScene(const std::vector<Ball>& newBalls,
+                const std::vector<KillVolume>& newKillVolumes);
+  friend std::ostream& operator<<(std::ostream& os, const Simulation& sim);
+  friend std::istream& operator>>(std::istream& is, Simulation& sim);
+  friend class StateSnapshot;
+};
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_STATESNAPSHOT_H_
+#define _PHY3D_STATESNAPSHOT_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Ball.h"
+#include "KillVolume.h"
+#include "Simulation.h"
+#include "Vec3.h"
+
+/**
+ * The complete dynamic state of a simulation: every ball with its velocity,
+ * angular velocity and orientation, the ids and the order of the balls, the
+ * kill volumes and the step counters. Restoring it continues the simulation
+ * exactly where it was taken, as long as the world geometry is the same. The
+ * balls are copied as plain memory, so taking a snapshot of thousands of
+ * balls is a single pass over the ball array.
+ *
+ * Snapshots can be saved into binary files for checkpoints. The arrays are
+ * stored as they are in memory, so the files can only be loaded by builds
+ * with the same byte order and ball layout, which the header records.
+ */
+class StateSnapshot {
+ private:
+  std::vector<BallState> balls;  // In the order of the ball array
+  std::vector<unsigned int> freeIds;
+  unsigned int idLimit;
+  std::vector<KillVolume> killVolumes;
+  Vec3 gravity;
+  int32_t stepsSinceReorder;
+  uint64_t stepCount;
+  int64_t accountedBytes;  // The size of the arrays reported to MemoryStats
+
+  void account();
+
+ public:
+  static constexpr uint32_t version = 1;
+
+  StateSnapshot();
+  ~StateSnapshot();
+  StateSnapshot(const StateSnapshot&) = delete;
+  StateSnapshot& operator=(const StateSnapshot&) = delete;
+  void capture(const Simulation& sim);
+  void restore(Simulation& sim) const;
+  uint64_t getStepCount() const { return stepCount; }
+  int getBallCount() const { return balls.size(); }
+  bool save(const char* fileName) const;
+  bool save(std::ostream& file) const;
+  bool load(const char* fileName);
+  bool load(std::istream& file, uint64_t end);
+};
+
+/**
+ * The last few snapshots of a simulation, for rewinding it. The snapshots
+ * are allocated once and reused, the oldest one is overwritten when the ring
+ * is full.
+ */
+class SnapshotRing {
+ private:
+  StateSnapshot* snapshots;
+  int capacity;
+  int newest;  // The index of the newest snapshot
+  int count;   // The number of snapshots stored
+
+ public:
+  SnapshotRing(int capacity_);
+  ~SnapshotRing();
+  SnapshotRing(const SnapshotRing&) = delete;
+  SnapshotRing& operator=(const SnapshotRing&) = delete;
+  void push(const Simulation& sim);
+  bool pop(Simulation& sim);
+  void clear() { count = 0; }
+  int size() const { return count; }
+  const StateSnapshot& get(int age) const;
+};
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#ifndef _PHY3D_WORLDSTREAMER_H_
+#define _PHY3D_WORLDSTREAMER_H_
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BakedScene.h"
+#include "Ball.h"
+#include "BallStore.h"
+#include "KillVolume.h"
+#include "Mesh.h"
+#include "Vec3.h"
+
+/**
+ * Streams the world geometry of a scene baked with a tile size. Only the
+ * tiles near the camera or a ball are read from the file, into the world
+ * mesh the simulation collides with, and the tiles that were not needed for
+ * the longest time are dropped while the tiles take more than the memory
+ * budget. After an update changed the tiles, the old vertex and triangle
+ * indices of the world can be mapped to the new ones, so the geometry caches
+ * of the balls far from the new tiles can be kept.
+ */
+class WorldStreamer {
+ private:
+  struct Tile {
+    BakedTile info;
+    bool resident;
+    bool wanted;                // Near the camera or a ball in this update
+    uint64_t lastWanted;        // The last update the tile was wanted in
+    unsigned int vertexBase;    // The first vertex in the world, if resident
+    unsigned int triangleBase;  // The first triangle in the world
+  };
+
+  std::string fileName;
+  std::ifstream file;
+  uint64_t vertexOffset;  // The geometry sections in the file
+  uint64_t indexOffset;
+  std::vector<Tile> tiles;
+  std::vector<int> resident;  // The resident tiles in the order of the world
+  // The tiles touching each cell of a grid on the horizontal plane
+  std::unordered_map<int64_t, std::vector<int>> cells;
+  float cellSize;
+  Vec3 boundsMin, boundsMax;  // The box of the whole world
+  size_t budget;              // The most bytes of tiles kept if not needed
+  size_t residentBytes;
+  uint64_t worldRevision;  // The world after the last rebuild
+  uint64_t updates;
+  float viewDistance;  // Tiles this close to the camera are loaded
+  float ballDistance;  // Tiles this close to the surface of a ball too
+  std::vector<unsigned int> vertexMap;  // The new index of each old vertex
+  std::vector<unsigned int> triangleMap;
+  std::vector<int> loaded;  // The tiles loaded by the last update
+  std::vector<int> evicted;
+
+  static size_t getTileBytes(const BakedTile& t) {
+    return 3 * (sizeof(float) * t.vertexCount +
+                sizeof(unsigned int) * t.triangleCount);
+  }
+  static int64_t getCellKey(int64_t x, int64_t z) {
+    return (int64_t)(((uint64_t)x << 32) ^ ((uint64_t)z & 0xffffffff));
+  }
+  void want(const Vec3& p, float distance);
+  bool readTile(const BakedTile& t, float* vertices, unsigned int* indices,
+                unsigned int vertexBase);
+  void rebuild(Mesh& world);
+
+ public:
+  static constexpr unsigned int removedIndex = UINT_MAX;
+#ifdef __EMSCRIPTEN__
+  static constexpr size_t defaultBudget = 32 << 20;
+#else
+  static constexpr size_t defaultBudget = 128 << 20;
+#endif
+
+  WorldStreamer(size_t budget_ = defaultBudget);
+  WorldStreamer(const WorldStreamer&) = delete;
+  WorldStreamer& operator=(const WorldStreamer&) = delete;
+  bool open(const char* fileName_, std::vector<Ball>& balls,
+            std::vector<KillVolume>& killVolumes);
+  void close();
+  bool isOpen() const { return !tiles.empty(); }
+  bool update(Mesh& world, const Vec3* camera, const BallStore& balls);
+  void copyTile(const Mesh& world, int tile, Mesh& out) const;
+  void setBudget(size_t bytes) { budget = bytes; }
+  size_t getBudget() const { return budget; }
+  void setViewDistance(float d) { viewDistance = d; }
+  void setBallDistance(float d) { ballDistance = d; }
+  const std::string& getFileName() const { return fileName; }
+  void getBounds(Vec3* min, Vec3* max) const;
+  int getTileNum() const { return tiles.size(); }
+  const BakedTile& getTile(int tile) const { return tiles[tile].info; }
+  bool isResident(int tile) const { return tiles[tile].resident; }
+  int getResidentNum() const { return resident.size(); }
+  size_t getResidentBytes() const { return residentBytes; }
+  const std::vector<int>& getLoaded() const { return loaded; }
+  const std::vector<int>& getEvicted() const { return evicted; }
+  const std::vector<unsigned int>& getVertexMap() const { return vertexMap; }
+  const std::vector<unsigned int>& getTriangleMap() const {
+    return triangleMap;
+  }
+};
+
+#endif
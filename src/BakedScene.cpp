@@ -0,0 +1,431 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "BakedScene.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "SceneWriter.h"
+#include "Simulation.h"
+
+namespace {
+
+const char magic[4] = {'M', 'R', 'S', 'B'};
+const size_t headerBytes = 16;  // Magic, version, section count, reserved
+const size_t entryBytes = 24;   // Type, count, offset and size of a section
+
+/**
+ * Returns true if the machine stores numbers in little-endian byte order,
+ * which the arrays of the file can be used in place with.
+ */
+bool isLittleEndian() {
+  uint16_t probe = 1;
+  unsigned char first;
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+/**
+ * Appends an unsigned integer of the given size to the buffer in
+ * little-endian byte order.
+ */
+void appendUint(std::string& buffer, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) buffer.push_back((char)(value >> (8 * i)));
+}
+
+/**
+ * Appends a float to the buffer in little-endian byte order.
+ */
+void appendFloat(std::string& buffer, float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  appendUint(buffer, bits, 4);
+}
+
+/**
+ * Reads a little-endian unsigned integer of the given size.
+ */
+uint64_t readUint(const char* p, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++)
+    value |= (uint64_t)(unsigned char)p[i] << (8 * i);
+  return value;
+}
+
+/**
+ * Reads a little-endian float.
+ */
+float readFloat(const char* p) {
+  uint32_t bits = readUint(p, 4);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * A section of the file, with the data to write or the location of the data
+ * in a loaded file.
+ */
+struct Section {
+  uint32_t type;
+  uint32_t count;
+  std::string data;
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+/**
+ * Orders the world geometry tile by tile. The triangles are put into the
+ * cells of a grid on the horizontal plane by their centroids, and every tile
+ * gets its own copy of the vertices its triangles use, so it can be loaded
+ * on its own. Vertices without triangles are dropped. The indices refer to
+ * the whole vertex array, so the file is still a normal baked scene.
+ */
+void buildTiles(const Mesh& world, float tileSize, std::vector<Vec3>& vertices,
+                std::vector<unsigned int>& indices,
+                std::vector<BakedTile>& tiles) {
+  std::map<std::pair<int64_t, int64_t>, std::vector<unsigned int>> cells;
+  for (unsigned int i = 0; i < world.getTriangleNum(); i++) {
+    Vec3 a, b, c;
+    world.getTriangle(i, &a, &b, &c);
+    float x = (a.x + b.x + c.x) / 3, z = (a.z + b.z + c.z) / 3;
+    cells[{(int64_t)std::floor(x / tileSize),
+           (int64_t)std::floor(z / tileSize)}]
+        .push_back(i);
+  }
+
+  // The tile that last copied each vertex, and where it copied it
+  std::vector<uint32_t> owner(world.getVertexNum(), UINT32_MAX);
+  std::vector<uint32_t> copy(world.getVertexNum());
+  for (const auto& cell : cells) {
+    BakedTile tile;
+    tile.firstVertex = vertices.size();
+    tile.firstTriangle = indices.size() / 3;
+    tile.triangleCount = cell.second.size();
+    for (unsigned int t : cell.second) {
+      unsigned int corner[3];
+      world.getTriangleIdx(t, &corner[0], &corner[1], &corner[2]);
+      for (unsigned int v : corner) {
+        if (owner[v] != tiles.size()) {
+          owner[v] = tiles.size();
+          copy[v] = vertices.size();
+          vertices.push_back(world.getVertex(v));
+        }
+        indices.push_back(copy[v]);
+      }
+    }
+    tile.vertexCount = vertices.size() - tile.firstVertex;
+    tile.min = tile.max = vertices[tile.firstVertex];
+    for (size_t i = tile.firstVertex; i < vertices.size(); i++) {
+      const Vec3& v = vertices[i];
+      tile.min = Vec3(std::fmin(tile.min.x, v.x), std::fmin(tile.min.y, v.y),
+                      std::fmin(tile.min.z, v.z));
+      tile.max = Vec3(std::fmax(tile.max.x, v.x), std::fmax(tile.max.y, v.y),
+                      std::fmax(tile.max.z, v.z));
+    }
+    tiles.push_back(tile);
+  }
+}
+
+/**
+ * Reads the number of sections from the header of a baked scene. Returns 0
+ * if the data does not start with a valid header and the whole table.
+ */
+uint64_t readSectionNum(const char* data, size_t size) {
+  if (size < headerBytes || std::memcmp(data, magic, sizeof(magic)) != 0 ||
+      readUint(data + 4, 4) != BakedScene::version)
+    return 0;
+  uint64_t sectionNum = readUint(data + 8, 4);
+  return size < headerBytes + entryBytes * sectionNum ? 0 : sectionNum;
+}
+
+/**
+ * Finds the known sections in the table following the header, checking that
+ * they are inside a file of the given size and have the size their element
+ * count requires. Returns false if a section is invalid.
+ */
+bool findSections(const char* data, uint64_t sectionNum, uint64_t fileSize,
+                  Section found[TILE_SECTION + 1]) {
+  static const uint64_t recordBytes[] = {0, 32, 24, 12, 12, 40};
+  for (uint64_t i = 0; i < sectionNum; i++) {
+    const char* entry = data + headerBytes + entryBytes * i;
+    Section s;
+    s.type = readUint(entry, 4);
+    s.count = readUint(entry + 4, 4);
+    s.offset = readUint(entry + 8, 8);
+    s.bytes = readUint(entry + 16, 8);
+    if (s.type < BALL_SECTION || s.type > TILE_SECTION) continue;
+    if (s.offset > fileSize || s.bytes > fileSize - s.offset ||
+        s.offset % 4 != 0 || s.bytes != s.count * recordBytes[s.type])
+      return false;
+    found[s.type] = s;
+  }
+  return true;
+}
+
+/**
+ * Appends the balls stored in a ball section.
+ */
+void readBalls(const float* data, uint32_t count, std::vector<Ball>& balls) {
+  for (uint32_t i = 0; i < count; i++) {
+    const float* b = data + 8 * i;
+    Ball newBall(Vec3(b[0], b[1], b[2]), b[3]);
+    newBall.setDensity(b[4]);
+    newBall.setAngularMassMultiplier(b[5]);
+    newBall.setBounciness(b[6]);
+    newBall.setFrictionCoefficient(b[7]);
+    balls.push_back(newBall);
+  }
+}
+
+/**
+ * Appends the kill volumes stored in a kill section.
+ */
+void readKillVolumes(const float* data, uint32_t count,
+                     std::vector<KillVolume>& killVolumes) {
+  for (uint32_t i = 0; i < count; i++) {
+    const float* k = data + 6 * i;
+    killVolumes.push_back(
+        KillVolume(Vec3(k[0], k[1], k[2]), Vec3(k[3], k[4], k[5])));
+  }
+}
+
+}  // namespace
+
+/**
+ * Returns true if the file starts with the magic of the baked scenes.
+ */
+bool BakedScene::isBaked(const char* fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  char start[sizeof(magic)];
+  return file.read(start, sizeof(start)) &&
+         std::memcmp(start, magic, sizeof(magic)) == 0;
+}
+
+/**
+ * Bakes the balls, kill volumes and world geometry of the simulation into the
+ * given file. If a tile size is given, the geometry is split into tiles of
+ * that size for streaming. Returns false if the file could not be written.
+ */
+bool BakedScene::save(const char* fileName, const Simulation& sim,
+                      float tileSize) {
+  std::vector<Section> sections(tileSize > 0 ? 5 : 4);
+  Section& balls = sections[0];
+  balls.type = BALL_SECTION;
+  std::vector<SavedBall> saved;
+  SceneWriter::collectBalls(sim.getBalls(), saved);
+  balls.count = saved.size();
+  for (const SavedBall& b : saved) {
+    float values[8];
+    b.getValues(values);
+    for (float v : values) appendFloat(balls.data, v);
+  }
+
+  Section& kills = sections[1];
+  kills.type = KILL_SECTION;
+  kills.count = sim.getKillVolumes().size();
+  for (const KillVolume& v : sim.getKillVolumes()) {
+    float values[] = {v.min.x, v.min.y, v.min.z, v.max.x, v.max.y, v.max.z};
+    for (float value : values) appendFloat(kills.data, value);
+  }
+
+  // The geometry is stored either in the order of the world or tile by tile
+  const Mesh& world = sim.getWorld();
+  std::vector<Vec3> vertexData;
+  std::vector<unsigned int> indexData;
+  std::vector<BakedTile> tiles;
+  if (tileSize > 0) {
+    buildTiles(world, tileSize, vertexData, indexData, tiles);
+  } else {
+    for (unsigned int i = 0; i < world.getVertexNum(); i++)
+      vertexData.push_back(world.getVertex(i));
+    indexData.resize(3 * (size_t)world.getTriangleNum());
+    for (unsigned int i = 0; i < world.getTriangleNum(); i++)
+      world.getTriangleIdx(i, &indexData[3 * i], &indexData[3 * i + 1],
+                           &indexData[3 * i + 2]);
+  }
+
+  Section& vertices = sections[2];
+  vertices.type = VERTEX_SECTION;
+  vertices.count = vertexData.size();
+  for (const Vec3& v : vertexData) {
+    appendFloat(vertices.data, v.x);
+    appendFloat(vertices.data, v.y);
+    appendFloat(vertices.data, v.z);
+  }
+
+  Section& indices = sections[3];
+  indices.type = INDEX_SECTION;
+  indices.count = indexData.size() / 3;
+  for (unsigned int i : indexData) appendUint(indices.data, i, 4);
+
+  if (tileSize > 0) {
+    Section& tileSection = sections[4];
+    tileSection.type = TILE_SECTION;
+    tileSection.count = tiles.size();
+    for (const BakedTile& t : tiles) {
+      float box[] = {t.min.x, t.min.y, t.min.z, t.max.x, t.max.y, t.max.z};
+      for (float value : box) appendFloat(tileSection.data, value);
+      appendUint(tileSection.data, t.firstVertex, 4);
+      appendUint(tileSection.data, t.vertexCount, 4);
+      appendUint(tileSection.data, t.firstTriangle, 4);
+      appendUint(tileSection.data, t.triangleCount, 4);
+    }
+  }
+
+  // Place the sections after the header and the table, each of them aligned
+  std::string header(magic, sizeof(magic));
+  appendUint(header, version, 4);
+  appendUint(header, sections.size(), 4);
+  appendUint(header, 0, 4);
+  uint64_t offset = headerBytes + entryBytes * sections.size();
+  for (Section& s : sections) {
+    offset = (offset + alignment - 1) / alignment * alignment;
+    appendUint(header, s.type, 4);
+    appendUint(header, s.count, 4);
+    appendUint(header, offset, 8);
+    appendUint(header, s.data.size(), 8);
+    s.offset = offset;
+    offset += s.data.size();
+  }
+
+  std::ofstream file(fileName, std::ios::binary);
+  file << header;
+  for (const Section& s : sections) {
+    file << std::string(s.offset - (uint64_t)file.tellp(), '\0') << s.data;
+  }
+  return (bool)file;
+}
+
+/**
+ * Loads a baked scene. The file is memory mapped and the mesh uses the vertex
+ * and index arrays in it directly, only the balls and kill volumes are
+ * copied. Returns false without changing the mesh if the file could not be
+ * read or is not a valid baked scene.
+ */
+bool BakedScene::load(const char* fileName, Mesh& mesh,
+                      std::vector<Ball>& balls,
+                      std::vector<KillVolume>& killVolumes) {
+  if (!isLittleEndian()) return false;
+  MappedFile* file = new MappedFile();
+  const char* data = NULL;
+  size_t size = 0;
+  if (file->open(fileName)) {
+    data = file->getData();
+    size = file->getSize();
+  }
+  uint64_t sectionNum = readSectionNum(data, size);
+  Section found[TILE_SECTION + 1] = {};
+  if (sectionNum == 0 || !findSections(data, sectionNum, size, found)) {
+    delete file;
+    return false;
+  }
+
+  const float* ballData = (const float*)(data + found[BALL_SECTION].offset);
+  const float* killData = (const float*)(data + found[KILL_SECTION].offset);
+  float* vertices = (float*)(file->getData() + found[VERTEX_SECTION].offset);
+  unsigned int* indices =
+      (unsigned int*)(file->getData() + found[INDEX_SECTION].offset);
+  unsigned int vertNum = found[VERTEX_SECTION].count;
+  unsigned int triangleNum = found[INDEX_SECTION].count;
+  // A corrupt index would make the collision detection read outside of the
+  // vertex array
+  for (size_t i = 0; i < 3 * (size_t)triangleNum; i++) {
+    if (indices[i] >= vertNum) {
+      delete file;
+      return false;
+    }
+  }
+
+  readBalls(ballData, found[BALL_SECTION].count, balls);
+  readKillVolumes(killData, found[KILL_SECTION].count, killVolumes);
+
+  // The mesh takes over the mapping with the arrays in it
+  mesh.releaseArrays();
+  mesh.mapping = file;
+  mesh.vertices = vertices;
+  mesh.vCount = 3 * vertNum;
+  mesh.indices = indices;
+  mesh.iCount = 3 * triangleNum;
+  mesh.setAccountedBytes(sizeof(float) * mesh.vCount +
+                         sizeof(unsigned int) * mesh.iCount);
+  return true;
+}
+
+/**
+ * Reads the tiles, balls and kill volumes of a scene baked with a tile size,
+ * without its geometry, which can then be read tile by tile. Returns false if
+ * the file could not be read, is not a valid baked scene or has no tiles.
+ */
+bool BakedScene::loadTiles(const char* fileName, BakedTileIndex& index,
+                           std::vector<Ball>& balls,
+                           std::vector<KillVolume>& killVolumes) {
+  if (!isLittleEndian()) return false;
+  std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) return false;
+  uint64_t size = file.tellg();
+  file.seekg(0);
+
+  // The header and the section table
+  std::vector<char> table(headerBytes);
+  if (!file.read(table.data(), headerBytes)) return false;
+  uint64_t entries = readUint(table.data() + 8, 4);
+  if (headerBytes + entryBytes * entries > size) return false;
+  table.resize(headerBytes + entryBytes * entries);
+  if (!file.read(table.data() + headerBytes, entryBytes * entries))
+    return false;
+  uint64_t sectionNum = readSectionNum(table.data(), table.size());
+  Section found[TILE_SECTION + 1] = {};
+  if (sectionNum == 0 || !findSections(table.data(), sectionNum, size, found) ||
+      found[TILE_SECTION].type != TILE_SECTION)
+    return false;
+
+  // Only the small sections are read
+  auto readSection = [&file](const Section& s, std::vector<char>& data) {
+    data.resize(s.bytes);
+    file.seekg(s.offset);
+    return (bool)file.read(data.data(), s.bytes);
+  };
+  std::vector<char> ballData, killData, tileData;
+  if (!readSection(found[BALL_SECTION], ballData) ||
+      !readSection(found[KILL_SECTION], killData) ||
+      !readSection(found[TILE_SECTION], tileData))
+    return false;
+
+  std::vector<BakedTile> tiles(found[TILE_SECTION].count);
+  for (size_t i = 0; i < tiles.size(); i++) {
+    const char* t = tileData.data() + 40 * i;
+    BakedTile& tile = tiles[i];
+    tile.min = Vec3(readFloat(t), readFloat(t + 4), readFloat(t + 8));
+    tile.max = Vec3(readFloat(t + 12), readFloat(t + 16), readFloat(t + 20));
+    tile.firstVertex = readUint(t + 24, 4);
+    tile.vertexCount = readUint(t + 28, 4);
+    tile.firstTriangle = readUint(t + 32, 4);
+    tile.triangleCount = readUint(t + 36, 4);
+    // The tiles are read from the file with these, so they have to be inside
+    // the geometry sections
+    if ((uint64_t)tile.firstVertex + tile.vertexCount >
+            found[VERTEX_SECTION].count ||
+        (uint64_t)tile.firstTriangle + tile.triangleCount >
+            found[INDEX_SECTION].count)
+      return false;
+  }
+
+  readBalls((const float*)ballData.data(), found[BALL_SECTION].count, balls);
+  readKillVolumes((const float*)killData.data(), found[KILL_SECTION].count,
+                  killVolumes);
+  index.tiles.swap(tiles);
+  index.vertexOffset = found[VERTEX_SECTION].offset;
+  index.indexOffset = found[INDEX_SECTION].offset;
+  return true;
+}
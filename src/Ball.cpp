@@ -8,6 +8,8 @@
 
 #include "Ball.h"
 
+#include <climits>
+
 /**
  * Initalises a ball.
  */
@@ -24,6 +26,34 @@ Ball::Ball(const Vec3& pos_, float radius) {
   // The friction coefficient and bounciness can be modified with setters later
   k = 0.2;
   fc = 0.2;
+  id = 0;
+  cachedMesh = NULL;
+}
+
+/**
+ * Returns the state of the ball that setState can restore.
+ */
+BallState Ball::getState() const {
+  return {pos, vel, angVel, orientation, r, density, angularMassMultiplier,
+          k, fc, id};
+}
+
+/**
+ * Restores the state of the ball returned by getState. The geometry cache is
+ * kept allocated, but it is rebuilt at the new position.
+ */
+void Ball::setState(const BallState& s) {
+  pos = s.pos;
+  vel = s.vel;
+  angVel = s.angVel;
+  orientation = s.orientation;
+  r = s.radius;
+  density = s.density;
+  angularMassMultiplier = s.angularMassMultiplier;
+  k = s.bounciness;
+  fc = s.frictionCoefficient;
+  id = s.id;
+  invalidateCache();
 }
 
 /**
@@ -106,59 +136,129 @@ Vec3 Ball::getVelInPos(const Vec3& p) const {
 
 /**
  * Tests collision against the given static model and applies the appropriate
- * collision response.
+ * collision response. Runs both phases of a physics step for a single ball,
+ * collecting the contacts into the arena, which is reset first, so it can be
+ * reused without allocating.
+ */
+void Ball::collideWithModel(const Mesh& m, ContactArena& found) {
+  found.reset();
+  findContacts(m, 0, found);
+  for (int i = 0; i < found.getCount(); i++) resolveContact(found[i].point);
+}
+
+/**
+ * Collects the vertices and triangles of the model that are closer than the
+ * radius plus the skin distance into the ball's cache. Triangles are selected
+ * by their bounding boxes, which is conservative but cheap.
+ */
+void Ball::rebuildCache(const Mesh& m) {
+  nearVertices.clear();
+  nearTriangles.clear();
+  float reach = r + getCacheSkin();
+
+  unsigned int vNum = m.getVertexNum();
+  for (unsigned int i = 0; i < vNum; i++) {
+    if ((m.getVertex(i) - pos).lenSq() <= reach * reach)
+      nearVertices.push_back(i);
+  }
+
+  unsigned int tNum = m.getTriangleNum();
+  for (unsigned int i = 0; i < tNum; i++) {
+    Vec3 a, b, c;
+    m.getTriangle(i, &a, &b, &c);
+    // Test the position against the bounding box grown by the reach
+    if (pos.x < std::fmin(a.x, std::fmin(b.x, c.x)) - reach ||
+        pos.x > std::fmax(a.x, std::fmax(b.x, c.x)) + reach ||
+        pos.y < std::fmin(a.y, std::fmin(b.y, c.y)) - reach ||
+        pos.y > std::fmax(a.y, std::fmax(b.y, c.y)) + reach ||
+        pos.z < std::fmin(a.z, std::fmin(b.z, c.z)) - reach ||
+        pos.z > std::fmax(a.z, std::fmax(b.z, c.z)) + reach)
+      continue;
+    nearTriangles.push_back(i);
+  }
+
+  cachePos = pos;
+  cachedMesh = &m;
+}
+
+/**
+ * Checks whether the cache of nearby geometry could be affected by a change
+ * of the world inside the given box, which is when the box reaches into the
+ * sphere the cache was built from.
+ */
+bool Ball::cacheOverlaps(const Vec3& min, const Vec3& max) const {
+  if (cachedMesh == NULL) return false;
+  float reach = r + getCacheSkin();
+  // The closest point of the box to the centre of the cache
+  Vec3 closest(std::fmin(std::fmax(cachePos.x, min.x), max.x),
+               std::fmin(std::fmax(cachePos.y, min.y), max.y),
+               std::fmin(std::fmax(cachePos.z, min.z), max.z));
+  return (closest - cachePos).lenSq() <= reach * reach;
+}
+
+/**
+ * Returns whether the cache holds the geometry of the model near the ball.
+ * It has to be rebuilt if the ball got too far from where it was built.
+ */
+bool Ball::isCacheValid(const Mesh& m) const {
+  float skin = getCacheSkin();
+  return cachedMesh == &m && (pos - cachePos).lenSq() <= skin * skin;
+}
+
+/**
+ * Moves the cache of nearby geometry over to the rearranged arrays of the
+ * same world, given the new index of every old vertex and triangle, or
+ * UINT_MAX for the removed ones. If some of the cached geometry was removed,
+ * the cache is invalidated and false is returned.
  */
-void Ball::collideWithModel(const Model& m) {
-  // If the ball overlaps with the geomerty of the model, this lambda function
-  // is called to apply the collision response
-  auto collideWithPoint = [&](const Vec3& v) {
+bool Ball::remapCache(const std::vector<unsigned int>& vertexMap,
+                      const std::vector<unsigned int>& triangleMap) {
+  if (cachedMesh == NULL) return true;
+  auto remap = [](std::vector<unsigned int>& cached,
+                  const std::vector<unsigned int>& map) {
+    for (unsigned int& i : cached) {
+      if (i >= map.size() || map[i] == UINT_MAX) return false;
+      i = map[i];
+    }
+    return true;
+  };
+  if (!remap(nearVertices, vertexMap) || !remap(nearTriangles, triangleMap)) {
+    invalidateCache();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Detection phase of the ball-world collisions. Collects the points of the
+ * given static model that the ball touches into the contact arena, using the
+ * given index to refer to this ball. Only the cache of nearby geometry is
+ * updated, the state of the ball is not modified. Returns the number of
+ * vertices and triangles tested. If a heatmap is given, the tests and contacts
+ * of every triangle are counted in it.
+ */
+int Ball::findContacts(const Mesh& m, int self, ContactArena& contacts,
+                       CollisionHeatmap* heatmap) {
+  if (!isCacheValid(m)) rebuildCache(m);
+
+  // If the ball overlaps with the geometry and moves towards it, the point is
+  // stored for the resolution phase
+  auto testPoint = [&](const Vec3& v, int triangle) {
     Vec3 d = Vec3::sub(v, pos);
     if (d.lenSq() > (r * r)) return;
     if ((vel.dot(d)) <= 0) return;
-    // Separate the bodies
-    d.setLen(r - d.len());
-    pos.sub(d);
-    // Calculate collision normal
-    Vec3 n = Vec3::sub(v, pos).setLen(1);
-    // Calculate change in velocity
-    Vec3 dv = n * (vel.dot(n)) * (1 + k);
-    vel.sub(dv);
-
-    // Collision point
-    Vec3 cp = v;
-    Vec3 vRel = -getVelInPos(
-        cp);  // The ball's relative velocity compared to the collision point
-    Vec3 t =
-        Vec3::sub(vRel, Vec3::mult(n, n.dot(vRel)));  // The collision tangent
-    t.setLen(1);
-    float mass = getMass();
-    float angularEffMass = getAngularMass() / (r * r);
-    float effMass = 1.0f / ((1.0f / mass) + (1.0f / angularEffMass));
-    float dImp = -dv.len() * mass * fc;
-    Vec3 fResp;
-    // If the friction response is too big (it would send the ball in the
-    // opposite direction), give it the max possible value
-    if (std::abs(vRel.dot(t) * effMass) <= std::abs(dImp)) {
-      fResp = Vec3::mult(t, vRel.dot(t) * effMass);
-    } else
-      fResp = Vec3::mult(t, -dImp);
-
-    // Change the velocity and angular velocity according to the friction
-    // impulse
-    d = Vec3::sub(cp, pos);
-    vel.add(Vec3::mult(fResp, 1.0f / mass));
-    angVel.add(Vec3::mult(d.cross(fResp), 1 / getAngularMass()));
+    contacts.addWorldContact(self, v, triangle);
+    if (heatmap != NULL && triangle >= 0) heatmap->addContact(triangle);
   };
 
-  // Test against the vertices of the model first
-  GLuint vNum = m.getVertexNum();
-  for (int i = 0; i < vNum; i++) {
-    collideWithPoint(m.getVertex(i));
+  // Test against the nearby vertices of the model first
+  for (unsigned int i : nearVertices) {
+    testPoint(m.getVertex(i), -1);
   }
 
-  // Then test against the triangles in the model
-  GLuint tNum = m.getTriangleNum();
-  for (int i = 0; i < tNum; i++) {
+  // Then test against the nearby triangles in the model
+  for (unsigned int i : nearTriangles) {
+    if (heatmap != NULL) heatmap->addTest(i);
     Vec3 a, b, c;
     m.getTriangle(i, &a, &b, &c);
     Vec3 AB = b - a;
@@ -179,22 +279,79 @@ void Ball::collideWithModel(const Model& m) {
       n.setLen(1);
       n.mult(n.dot(aRel));
       Vec3 cp = Vec3::sub(pos, n);
-      collideWithPoint(cp);
+      testPoint(cp, i);
     }
   }
 
   // I haven't yet implemented edge collision detection, but the algorithm is
   // slow enough already and the collsions look realistic so I probably won't
   // implement it since it is not worth it
+
+  return nearVertices.size() + nearTriangles.size();
 }
 
 /**
- * Tests the collision between two balls and applies response if needed.
+ * Resolution phase of a ball-world collision with the given point of the
+ * static geometry. The overlap is tested again, because an earlier contact of
+ * the same step might have already pushed the ball away. Returns true if a
+ * response was applied.
  */
-void Ball::collide(Ball& b1, Ball& b2) {
+bool Ball::resolveContact(const Vec3& v) {
+  Vec3 d = Vec3::sub(v, pos);
+  if (d.lenSq() > (r * r)) return false;
+  if ((vel.dot(d)) <= 0) return false;
+  // Separate the bodies
+  d.setLen(r - d.len());
+  pos.sub(d);
+  // Calculate collision normal
+  Vec3 n = Vec3::sub(v, pos).setLen(1);
+  // Calculate change in velocity
+  Vec3 dv = n * (vel.dot(n)) * (1 + k);
+  vel.sub(dv);
+
+  // Collision point
+  Vec3 cp = v;
+  Vec3 vRel = -getVelInPos(
+      cp);  // The ball's relative velocity compared to the collision point
+  Vec3 t =
+      Vec3::sub(vRel, Vec3::mult(n, n.dot(vRel)));  // The collision tangent
+  t.setLen(1);
+  float mass = getMass();
+  float angularEffMass = getAngularMass() / (r * r);
+  float effMass = 1.0f / ((1.0f / mass) + (1.0f / angularEffMass));
+  float dImp = -dv.len() * mass * fc;
+  Vec3 fResp;
+  // If the friction response is too big (it would send the ball in the
+  // opposite direction), give it the max possible value
+  if (std::abs(vRel.dot(t) * effMass) <= std::abs(dImp)) {
+    fResp = Vec3::mult(t, vRel.dot(t) * effMass);
+  } else
+    fResp = Vec3::mult(t, -dImp);
+
+  // Change the velocity and angular velocity according to the friction
+  // impulse
+  d = Vec3::sub(cp, pos);
+  vel.add(Vec3::mult(fResp, 1.0f / mass));
+  angVel.add(Vec3::mult(d.cross(fResp), 1 / getAngularMass()));
+  return true;
+}
+
+/**
+ * Returns true if the two balls overlap.
+ */
+bool Ball::overlaps(const Ball& b1, const Ball& b2) {
   float R = b1.r + b2.r;
+  return (b1.pos - b2.pos).lenSq() <= (R * R);
+}
+
+/**
+ * Tests the collision between two balls and applies response if needed.
+ * Returns true if the velocities of the balls were changed.
+ */
+bool Ball::collide(Ball& b1, Ball& b2) {
   // Return if they do not overlap
-  if ((R * R) < (b1.pos - b2.pos).lenSq()) return;
+  if (!overlaps(b1, b2)) return false;
+  float R = b1.r + b2.r;
   // Separate the balls
   float m1 = b1.getMass(), m2 = b2.getMass();
   float am1 = b1.getAngularMass(), am2 = b2.getAngularMass();
@@ -206,7 +363,7 @@ void Ball::collide(Ball& b1, Ball& b2) {
   // Do not do anything if they are moving away from each other
   Vec3& n = d.setLen(1.0f);
   float v1 = n.dot(b1.vel), v2 = n.dot(b2.vel);
-  if (v2 >= v1) return;
+  if (v2 >= v1) return false;
 
   // Calculate collision response
   Vec3 p = b1.pos + (n * b1.r);
@@ -249,4 +406,5 @@ void Ball::collide(Ball& b1, Ball& b2) {
   b2.vel.add(Vec3::mult(fResp, 1.0f / m2));
   b1.angVel.sub(r1.cross(fResp) * (1.0f / am1));
   b2.angVel.add(r2.cross(fResp) * (1.0f / am2));
+  return true;
 }
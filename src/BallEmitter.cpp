@@ -0,0 +1,115 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "BallEmitter.h"
+
+/**
+ * Initialises an emitter that spawns count balls with the given rate.
+ */
+BallEmitter::BallEmitter(EmitterPattern pattern_, int count,
+                         float ballsPerSecond, const Ball& proto)
+    : pattern(pattern_), prototype(proto) {
+  total = count;
+  spawned = 0;
+  rate = ballsPerSecond;
+  accumulator = 0.0f;
+  boxMin = boxMax = streamFrom = proto.getPosition();
+  streamVel = proto.getVel();
+  rngState = 1;
+}
+
+/**
+ * Sets the box used by the grid and jittered patterns.
+ */
+void BallEmitter::setBox(const Vec3& min, const Vec3& max) {
+  boxMin = min;
+  boxMax = max;
+}
+
+/**
+ * Sets the starting point and velocity of the streamed balls. Can be called
+ * every frame to make the stream follow the camera.
+ */
+void BallEmitter::setStream(const Vec3& from, const Vec3& vel) {
+  streamFrom = from;
+  streamVel = vel;
+}
+
+/**
+ * Returns a pseudo random number in [0, 1). A simple xorshift generator is used
+ * so spawning is reproducible on every platform with the same seed.
+ */
+float BallEmitter::random() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return (rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * Returns the position of the next ball to spawn.
+ */
+Vec3 BallEmitter::nextPosition() {
+  float r = prototype.getRadius();
+  switch (pattern) {
+    case GRID_EMITTER: {
+      // Fill the box layer by layer from the bottom, leaving a small gap
+      // between the balls
+      float spacing = 2.2f * r;
+      int nx = std::max(1, (int)((boxMax.x - boxMin.x) / spacing) + 1);
+      int nz = std::max(1, (int)((boxMax.z - boxMin.z) / spacing) + 1);
+      int i = spawned;
+      return Vec3(boxMin.x + (i % nx) * spacing,
+                  boxMin.y + (i / (nx * nz)) * spacing,
+                  boxMin.z + ((i / nx) % nz) * spacing);
+    }
+    case JITTER_EMITTER:
+      return Vec3(boxMin.x + random() * (boxMax.x - boxMin.x),
+                  boxMin.y + random() * (boxMax.y - boxMin.y),
+                  boxMin.z + random() * (boxMax.z - boxMin.z));
+    case STREAM_EMITTER:
+    default:
+      // Jitter the start a little so consecutive balls do not stack exactly
+      return streamFrom + Vec3(random() - 0.5f, random() - 0.5f,
+                               random() - 0.5f) * r;
+  }
+}
+
+/**
+ * Reserves space in the store for every ball the emitter is going to spawn.
+ */
+void BallEmitter::start(BallStore& store) {
+  store.reserve(store.size() + getRemaining());
+}
+
+/**
+ * Spawns the balls due in the elapsed time. Returns the number of new balls.
+ */
+int BallEmitter::update(float dt, BallStore& store) {
+  if (isFinished()) return 0;
+  accumulator += dt * rate;
+  int n = std::min((int)accumulator, getRemaining());
+  accumulator -= n;
+  for (int i = 0; i < n; i++) {
+    Ball b = prototype;
+    b.setPosition(nextPosition());
+    if (pattern == STREAM_EMITTER) b.setVel(streamVel);
+    store.add(b);
+    spawned++;
+  }
+  return n;
+}
+
+/**
+ * Spawns every remaining ball at once, regardless of the rate.
+ */
+int BallEmitter::spawnAll(BallStore& store) {
+  start(store);
+  accumulator = (float)getRemaining();
+  return update(0.0f, store);
+}
@@ -0,0 +1,203 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "BallStore.h"
+
+/**
+ * Initialises an empty store, memory is only allocated when the first ball is
+ * added.
+ */
+BallStore::BallStore() {
+  balls = NULL;
+  count = capacity = 0;
+  slots = NULL;
+  freeIds = NULL;
+  idCount = idCapacity = freeCount = 0;
+}
+
+/**
+ * Frees the memory of the balls and the id tables.
+ */
+BallStore::~BallStore() {
+  delete[] balls;
+  delete[] slots;
+  delete[] freeIds;
+  MemoryStats::add(BALL_MEMORY, -(int64_t)sizeof(Ball) * capacity -
+                                    (int64_t)idBytes * idCapacity);
+}
+
+/**
+ * Moves the balls into a new array with the given capacity.
+ */
+void BallStore::growBalls(int newCapacity) {
+  Ball* newAddr = new Ball[newCapacity];
+  // The balls own their geometry caches so they have to be moved one by one
+  for (int i = 0; i < count; i++) newAddr[i] = std::move(balls[i]);
+  delete[] balls;
+  balls = newAddr;
+  MemoryStats::add(BALL_MEMORY,
+                   (int64_t)sizeof(Ball) * (newCapacity - capacity));
+  capacity = newCapacity;
+}
+
+/**
+ * Enlarges the id lookup table and the free id stack to the given capacity.
+ */
+void BallStore::growIds(unsigned int newCapacity) {
+  int* newSlots = new int[newCapacity];
+  unsigned int* newFree = new unsigned int[newCapacity];
+  std::copy(slots, slots + idCount, newSlots);
+  std::copy(freeIds, freeIds + freeCount, newFree);
+  delete[] slots;
+  delete[] freeIds;
+  slots = newSlots;
+  freeIds = newFree;
+  MemoryStats::add(BALL_MEMORY,
+                   (int64_t)idBytes * ((int64_t)newCapacity - idCapacity));
+  idCapacity = newCapacity;
+}
+
+/**
+ * Makes sure that at least n balls fit into the store without reallocating.
+ */
+void BallStore::reserve(int n) {
+  if (n > capacity) growBalls(n);
+  if ((unsigned int)n > idCapacity) growIds(n);
+}
+
+/**
+ * Appends a copy of the ball to the store and returns the id it got. Takes
+ * amortized constant time.
+ */
+unsigned int BallStore::add(const Ball& b) {
+  if (count == capacity) growBalls(capacity < 16 ? 16 : capacity * 2);
+
+  // Reuse the id of a removed ball if there is one
+  unsigned int id;
+  if (freeCount > 0)
+    id = freeIds[--freeCount];
+  else {
+    if (idCount == idCapacity) growIds(idCapacity < 16 ? 16 : idCapacity * 2);
+    id = idCount++;
+  }
+
+  balls[count] = b;
+  balls[count].setId(id);
+  slots[id] = count;
+  count++;
+  return id;
+}
+
+/**
+ * Removes the ball with the given id. Returns false if there is no such ball.
+ */
+bool BallStore::remove(unsigned int id) {
+  if (id >= idCount || slots[id] < 0) return false;
+  removeAt(slots[id]);
+  return true;
+}
+
+/**
+ * Removes the ball at the given index of the dense array. The last ball is
+ * moved into its place, so the order of the balls changes.
+ */
+void BallStore::removeAt(int index) {
+  unsigned int id = balls[index].getId();
+  count--;
+  if (index != count) {
+    balls[index] = std::move(balls[count]);
+    slots[balls[index].getId()] = index;
+  }
+  slots[id] = -1;
+  freeIds[freeCount++] = id;
+}
+
+/**
+ * Removes every ball. The allocated memory is kept for later use.
+ */
+void BallStore::clear() {
+  for (int i = 0; i < count; i++) balls[i] = Ball();
+  count = 0;
+  idCount = 0;
+  freeCount = 0;
+}
+
+/**
+ * Replaces the balls with the given states, in the same order, and the ids
+ * handed out so far with the given ones. The free id stack is restored as
+ * well, so the following balls get the same ids as they did after the
+ * states were taken. The memory of the store and the balls is reused.
+ */
+void BallStore::restore(const BallState* states, int n, unsigned int idLimit,
+                        const unsigned int* free, unsigned int freeNum) {
+  for (int i = n; i < count; i++) balls[i] = Ball();
+  if (n > capacity) growBalls(n);
+  if (idLimit > idCapacity) growIds(idLimit);
+  count = n;
+  idCount = idLimit;
+  std::fill(slots, slots + idCount, -1);
+  for (int i = 0; i < n; i++) {
+    balls[i].setState(states[i]);
+    slots[states[i].id] = i;
+  }
+  std::copy(free, free + freeNum, freeIds);
+  freeCount = freeNum;
+}
+
+/**
+ * Returns the ball with the given id or NULL if there is no such ball. The
+ * returned pointer is only valid until the store is modified or reordered.
+ */
+Ball* BallStore::find(unsigned int id) {
+  if (id >= idCount || slots[id] < 0) return NULL;
+  return &balls[slots[id]];
+}
+
+/**
+ * Const version of the id lookup.
+ */
+const Ball* BallStore::find(unsigned int id) const {
+  if (id >= idCount || slots[id] < 0) return NULL;
+  return &balls[slots[id]];
+}
+
+/**
+ * Reorders the ball array by the Morton code of the balls' positions, so balls
+ * that are close to each other in space are also close in memory. The ids of
+ * the balls stay the same, only the lookup table is updated.
+ */
+void BallStore::sortByMorton() {
+  if (count < 2) return;
+
+  // Find the bounding box of the balls
+  Vec3 min = balls[0].getPosition(), max = min;
+  for (int i = 1; i < count; i++) {
+    Vec3 p = balls[i].getPosition();
+    min = Vec3(std::min(min.x, p.x), std::min(min.y, p.y),
+               std::min(min.z, p.z));
+    max = Vec3(std::max(max.x, p.x), std::max(max.y, p.y),
+               std::max(max.z, p.z));
+  }
+  float extent =
+      std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+  float scale = extent > 0.0f ? 1023.0f / extent : 0.0f;
+
+  // Sort (code, index) pairs then move the balls into their new places
+  std::pair<uint32_t, int>* order = new std::pair<uint32_t, int>[count];
+  for (int i = 0; i < count; i++)
+    order[i] = {Morton::encode(balls[i].getPosition(), min, scale), i};
+  std::sort(order, order + count);
+  Ball* sorted = new Ball[capacity];
+  for (int i = 0; i < count; i++) {
+    sorted[i] = std::move(balls[order[i].second]);
+    slots[sorted[i].getId()] = i;
+  }
+  delete[] order;
+  delete[] balls;
+  balls = sorted;
+}
@@ -0,0 +1,60 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "CollisionHeatmap.h"
+
+/**
+ * Removes the counters from the memory accounting.
+ */
+CollisionHeatmap::~CollisionHeatmap() {
+  MemoryStats::add(HEATMAP_MEMORY, -getBytes());
+}
+
+/**
+ * Returns the size of the counter arrays.
+ */
+int64_t CollisionHeatmap::getBytes() const {
+  return sizeof(uint32_t) * (tests.capacity() + contacts.capacity());
+}
+
+/**
+ * Clears the counters and sizes them for a world with the given number of
+ * triangles, freeing the memory of a larger previous world.
+ */
+void CollisionHeatmap::reset(unsigned int triangleNum) {
+  int64_t before = getBytes();
+  std::vector<uint32_t>(triangleNum, 0).swap(tests);
+  std::vector<uint32_t>(triangleNum, 0).swap(contacts);
+  MemoryStats::add(HEATMAP_MEMORY, getBytes() - before);
+}
+
+/**
+ * Returns the highest test count of a single triangle.
+ */
+uint32_t CollisionHeatmap::getMaxTests() const {
+  uint32_t max = 0;
+  for (uint32_t t : tests)
+    if (t > max) max = t;
+  return max;
+}
+
+/**
+ * Writes a CSV line for every triangle of the given mesh, which has to be the
+ * one the counters were collected on.
+ */
+void CollisionHeatmap::writeCsv(std::ostream& os, const Mesh& m) const {
+  os << "triangle,tests,contacts,center_x,center_y,center_z,area\n";
+  for (unsigned int i = 0; i < getTriangleNum(); i++) {
+    Vec3 a, b, c;
+    m.getTriangle(i, &a, &b, &c);
+    Vec3 center = (a + b + c) * (1.0f / 3.0f);
+    float area = Vec3::cross(b - a, c - a).len() / 2.0f;
+    os << i << ',' << tests[i] << ',' << contacts[i] << ',' << center.x << ','
+       << center.y << ',' << center.z << ',' << area << '\n';
+  }
+}
@@ -0,0 +1,290 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "CompressedScene.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "MappedFile.h"
+#include "EntropyCoder.h"
+#include "SceneWriter.h"
+#include "Simulation.h"
+
+namespace {
+
+const char magic[4] = {'M', 'R', 'S', 'C'};
+const size_t headerBytes = 44;
+// The models of the numbers: the three axes of the vertex deltas, then the
+// three corners of the index deltas
+const int modelNum = 6;
+const int firstCornerModel = 3;
+
+/**
+ * Appends a 32 bit unsigned integer to the buffer in little-endian byte
+ * order.
+ */
+void appendUint(std::string& buffer, uint32_t value) {
+  for (int i = 0; i < 4; i++) buffer.push_back((char)(value >> (8 * i)));
+}
+
+/**
+ * Returns the bits of a float as an unsigned integer.
+ */
+uint32_t floatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+/**
+ * Returns the float with the given bits.
+ */
+float bitsFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Reads a little-endian 32 bit unsigned integer.
+ */
+uint32_t readUint(const char* p) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++) value |= (uint32_t)(unsigned char)p[i] << (8 * i);
+  return value;
+}
+
+/**
+ * Decodes a number coded as its bit length followed by the bits after the
+ * leading one.
+ */
+inline uint32_t decodeNumber(EntropyCoder::Decoder& coded,
+                             const EntropyCoder::FrequencyTable& table,
+                             EntropyCoder::BitReader& raw) {
+  int length = coded.get(table);
+  if (length < 2) return length;
+  return (1u << (length - 1)) | raw.read(length - 1);
+}
+
+}  // namespace
+
+/**
+ * Returns true if the file starts with the magic of the compressed scenes.
+ */
+bool CompressedScene::isCompressed(const char* fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  char start[sizeof(magic)];
+  return file.read(start, sizeof(start)) &&
+         std::memcmp(start, magic, sizeof(magic)) == 0;
+}
+
+/**
+ * Compresses the balls, kill volumes and world geometry of the simulation into
+ * the given file, with the vertices rounded to the given step. Returns false
+ * if the file could not be written, or the step is too small for the size of
+ * the world.
+ */
+bool CompressedScene::save(const char* fileName, const Simulation& sim,
+                           float step) {
+  const Mesh& world = sim.getWorld();
+  Vec3 origin, max;
+  if (!world.getBounds(&origin, &max)) origin = max = Vec3(0, 0, 0);
+  Vec3 size = max - origin;
+  if (!(step > 0) || std::fmax(size.x, std::fmax(size.y, size.z)) / step >=
+                         (float)(1u << 30))
+    return false;
+
+  std::vector<SavedBall> balls;
+  SceneWriter::collectBalls(sim.getBalls(), balls);
+  const std::vector<KillVolume>& kills = sim.getKillVolumes();
+
+  std::string data(magic, sizeof(magic));
+  appendUint(data, version);
+  appendUint(data, balls.size());
+  appendUint(data, kills.size());
+  appendUint(data, world.getVertexNum());
+  appendUint(data, world.getTriangleNum());
+  appendUint(data, floatBits(step));
+  appendUint(data, floatBits(origin.x));
+  appendUint(data, floatBits(origin.y));
+  appendUint(data, floatBits(origin.z));
+
+  // The few balls and kill volumes are stored exactly in the bit stream
+  std::string plain;
+  EntropyCoder::BitWriter raw(plain);
+  for (const SavedBall& b : balls) {
+    float values[8];
+    b.getValues(values);
+    for (float v : values) raw.write(floatBits(v), 32);
+  }
+  for (const KillVolume& v : kills) {
+    float values[] = {v.min.x, v.min.y, v.min.z, v.max.x, v.max.y, v.max.z};
+    for (float value : values) raw.write(floatBits(value), 32);
+  }
+
+  // Collect the numbers to code with their models. The vertices are stored
+  // as the difference of their grid coordinates from the previous vertex, as
+  // the neighbouring vertices of the files tend to be close, and the indices
+  // as the difference from the previous index.
+  std::vector<uint32_t> numbers;
+  std::vector<uint8_t> models;
+  int32_t prev[3] = {0, 0, 0};
+  for (unsigned int i = 0; i < world.getVertexNum(); i++) {
+    Vec3 v = world.getVertex(i) - origin;
+    int32_t q[3] = {(int32_t)std::lround(v.x / step),
+                    (int32_t)std::lround(v.y / step),
+                    (int32_t)std::lround(v.z / step)};
+    for (int a = 0; a < 3; a++) {
+      numbers.push_back(EntropyCoder::zigzag(q[a] - prev[a]));
+      models.push_back(a);
+      prev[a] = q[a];
+    }
+  }
+  int32_t prevIndex = 0;
+  for (unsigned int i = 0; i < world.getTriangleNum(); i++) {
+    unsigned int idx[3];
+    world.getTriangleIdx(i, &idx[0], &idx[1], &idx[2]);
+    for (int c = 0; c < 3; c++) {
+      numbers.push_back(EntropyCoder::zigzag((int32_t)idx[c] - prevIndex));
+      models.push_back(firstCornerModel + c);
+      prevIndex = idx[c];
+    }
+  }
+
+  // Build the frequency tables of the bit lengths, and write the bits after
+  // the leading ones into the bit stream
+  uint32_t counts[modelNum][EntropyCoder::symbolNum] = {};
+  for (size_t i = 0; i < numbers.size(); i++) {
+    int length = EntropyCoder::bitLength(numbers[i]);
+    counts[models[i]][length]++;
+    if (length >= 2) raw.write(numbers[i], length - 1);
+  }
+  raw.flush();
+  std::vector<EntropyCoder::FrequencyTable> tables(modelNum);
+  std::string coded;
+  for (int m = 0; m < modelNum; m++) {
+    tables[m].build(counts[m]);
+    tables[m].write(coded);
+  }
+
+  // rANS codes in reverse order
+  EntropyCoder::Encoder encoder;
+  for (size_t i = numbers.size(); i-- > 0;)
+    encoder.put(tables[models[i]], EntropyCoder::bitLength(numbers[i]));
+  encoder.finish(coded);
+
+  appendUint(data, coded.size());
+  data += coded;
+  data += plain;
+
+  std::ofstream file(fileName, std::ios::binary);
+  file << data;
+  return (bool)file;
+}
+
+/**
+ * Loads a compressed scene, decoding the geometry straight into the arrays of
+ * the mesh. Returns false without changing the mesh if the file could not be
+ * read or is not a valid compressed scene.
+ */
+bool CompressedScene::load(const char* fileName, Mesh& mesh,
+                           std::vector<Ball>& balls,
+                           std::vector<KillVolume>& killVolumes) {
+  MappedFile file;
+  if (!file.open(fileName) || file.getSize() < headerBytes) return false;
+  const char* data = file.getData();
+  if (std::memcmp(data, magic, sizeof(magic)) != 0 ||
+      readUint(data + 4) != version)
+    return false;
+  uint32_t ballNum = readUint(data + 8);
+  uint32_t killNum = readUint(data + 12);
+  uint32_t vertNum = readUint(data + 16);
+  uint32_t triangleNum = readUint(data + 20);
+  float step = bitsFloat(readUint(data + 24));
+  Vec3 origin(bitsFloat(readUint(data + 28)), bitsFloat(readUint(data + 32)),
+              bitsFloat(readUint(data + 36)));
+  // Every element takes at least a bit, larger counts come from a corrupt
+  // header and would make the allocations fail
+  uint64_t maxElements = 8 * (uint64_t)file.getSize();
+  if (ballNum > maxElements || killNum > maxElements ||
+      vertNum > maxElements || triangleNum > maxElements)
+    return false;
+
+  uint32_t codedBytes = readUint(data + 40);
+  if (codedBytes > file.getSize() - headerBytes) return false;
+  const char* coded = data + headerBytes;
+  const char* codedEnd = coded + codedBytes;
+  std::vector<EntropyCoder::FrequencyTable> tables(modelNum);
+  for (int m = 0; m < modelNum; m++)
+    if (!tables[m].read(coded, codedEnd)) return false;
+  // The tables of the models that are used can not be empty
+  for (int m = 0; m < modelNum; m++) {
+    if (tables[m].isEmpty() &&
+        (m < firstCornerModel ? vertNum : triangleNum) > 0)
+      return false;
+  }
+  EntropyCoder::Decoder decoder(coded, codedEnd);
+  EntropyCoder::BitReader raw(codedEnd, data + file.getSize());
+
+  for (uint32_t i = 0; i < ballNum; i++) {
+    float b[8];
+    for (float& v : b) v = bitsFloat(raw.read(32));
+    Ball newBall(Vec3(b[0], b[1], b[2]), b[3]);
+    newBall.setDensity(b[4]);
+    newBall.setAngularMassMultiplier(b[5]);
+    newBall.setBounciness(b[6]);
+    newBall.setFrictionCoefficient(b[7]);
+    balls.push_back(newBall);
+  }
+  for (uint32_t i = 0; i < killNum; i++) {
+    float k[6];
+    for (float& v : k) v = bitsFloat(raw.read(32));
+    killVolumes.push_back(
+        KillVolume(Vec3(k[0], k[1], k[2]), Vec3(k[3], k[4], k[5])));
+  }
+
+  float* vertices = new float[3 * (size_t)vertNum];
+  uint32_t q[3] = {0, 0, 0};
+  float originAxis[3] = {origin.x, origin.y, origin.z};
+  for (size_t i = 0; i < 3 * (size_t)vertNum; i += 3) {
+    for (int a = 0; a < 3; a++) {
+      uint32_t delta = decodeNumber(decoder, tables[a], raw);
+      q[a] += (uint32_t)EntropyCoder::unzigzag(delta);
+      vertices[i + a] = originAxis[a] + (int32_t)q[a] * step;
+    }
+  }
+
+  unsigned int* indices = new unsigned int[3 * (size_t)triangleNum];
+  uint32_t index = 0;
+  for (size_t i = 0; i < 3 * (size_t)triangleNum; i++) {
+    const EntropyCoder::FrequencyTable& table =
+        tables[firstCornerModel + i % 3];
+    index += (uint32_t)EntropyCoder::unzigzag(
+        decodeNumber(decoder, table, raw));
+    // A corrupt index would make the collision detection read outside of the
+    // vertex array
+    if (index >= vertNum) {
+      delete[] vertices;
+      delete[] indices;
+      return false;
+    }
+    indices[i] = index;
+  }
+
+  mesh.releaseArrays();
+  mesh.vertices = vertices;
+  mesh.vCount = 3 * vertNum;
+  mesh.indices = indices;
+  mesh.iCount = 3 * triangleNum;
+  mesh.setAccountedBytes(sizeof(float) * mesh.vCount +
+                         sizeof(unsigned int) * mesh.iCount);
+  return true;
+}
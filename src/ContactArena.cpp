@@ -0,0 +1,69 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "ContactArena.h"
+
+/**
+ * Preallocates space for the given number of contacts.
+ */
+ContactArena::ContactArena(int initialCapacity) {
+  capacity = initialCapacity > 0 ? initialCapacity : 1;
+  contacts = new Contact[capacity];
+  MemoryStats::add(CONTACT_MEMORY, (int64_t)sizeof(Contact) * capacity);
+  count = 0;
+  highWaterMark = 0;
+}
+
+/**
+ * Frees the memory of the arena.
+ */
+ContactArena::~ContactArena() {
+  delete[] contacts;
+  MemoryStats::add(CONTACT_MEMORY, -(int64_t)sizeof(Contact) * capacity);
+}
+
+/**
+ * Bumps the end of the buffer and returns the newly reserved contact. The
+ * buffer only grows when a step produces more contacts than ever before.
+ */
+Contact& ContactArena::push() {
+  if (count == capacity) {
+    // Double the space, this only happens until the high-water mark settles
+    Contact* newAddr = new Contact[capacity * 2];
+    for (int i = 0; i < count; i++) newAddr[i] = contacts[i];
+    delete[] contacts;
+    contacts = newAddr;
+    MemoryStats::add(CONTACT_MEMORY, (int64_t)sizeof(Contact) * capacity);
+    capacity *= 2;
+  }
+  count++;
+  if (count > highWaterMark) highWaterMark = count;
+  return contacts[count - 1];
+}
+
+/**
+ * Stores a contact between a ball and a point of the static geometry, found on
+ * the given triangle or on a vertex if the triangle is -1.
+ */
+void ContactArena::addWorldContact(int ball, const Vec3& p, int triangle) {
+  Contact& c = push();
+  c.ball = ball;
+  c.other = -1;
+  c.point = p;
+  c.triangle = triangle;
+}
+
+/**
+ * Stores a contact between two balls.
+ */
+void ContactArena::addBallContact(int ball1, int ball2) {
+  Contact& c = push();
+  c.ball = ball1;
+  c.other = ball2;
+  c.triangle = -1;
+}
@@ -0,0 +1,155 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "FrameRecorder.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> FrameRecorder::enabled(true);
+std::atomic<uint32_t> FrameRecorder::frame(0);
+uint64_t FrameRecorder::frameStart = 0;
+uint64_t FrameRecorder::hitchThreshold = 0;
+uint32_t FrameRecorder::lastAutoDump = 0;
+int FrameRecorder::autoDumps = 0;
+std::string FrameRecorder::hitchPrefix = "hitch";
+
+namespace {
+/**
+ * The ring buffer of a single thread. Only its own thread writes it. The
+ * count of events started is raised before a slot is written and the count
+ * of events written after it, like a sequence lock, so a dump on another
+ * thread can tell which of the slots it copied were overwritten meanwhile.
+ */
+struct TraceRing {
+  TraceEvent events[FrameRecorder::ringSize];
+  std::atomic<uint64_t> started{0};
+  std::atomic<uint64_t> written{0};
+  int threadId;
+};
+
+// Every ring ever created, kept alive until exit so that rings of finished
+// threads can still be dumped
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<TraceRing>> rings;
+
+/**
+ * Returns the ring of the calling thread, creating it on first use.
+ */
+TraceRing* threadRing() {
+  thread_local TraceRing* ring = NULL;
+  if (ring == NULL) {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.emplace_back(new TraceRing());
+    ring = rings.back().get();
+    ring->threadId = (int)rings.size();
+  }
+  return ring;
+}
+}  // namespace
+
+/**
+ * Stores a zone that ran between the given times on the calling thread.
+ */
+void FrameRecorder::record(const char* name, uint64_t start, uint64_t end) {
+  TraceRing* ring = threadRing();
+  uint64_t pos = ring->written.load(std::memory_order_relaxed);
+  ring->started.store(pos + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceEvent& e = ring->events[pos % ringSize];
+  e.name = name;
+  e.start = start;
+  e.duration = end - start;
+  e.frame = frame.load(std::memory_order_relaxed);
+  ring->written.store(pos + 1, std::memory_order_release);
+}
+
+/**
+ * Marks the start of a new frame.
+ */
+void FrameRecorder::beginFrame() {
+  frame.fetch_add(1, std::memory_order_relaxed);
+  frameStart = now();
+}
+
+/**
+ * Marks the end of the current frame, records it as a zone and returns its
+ * length in nanoseconds. If the frame took longer than the hitch threshold,
+ * the last frames are dumped automatically, at most once every dumpFrames
+ * and maxAutoDumps times in total.
+ */
+uint64_t FrameRecorder::endFrame() {
+  uint64_t end = now();
+  uint64_t length = end - frameStart;
+  if (!isEnabled()) return length;
+  record("frame", frameStart, end);
+
+  uint32_t f = getFrame();
+  if (hitchThreshold > 0 && length > hitchThreshold &&
+      autoDumps < maxAutoDumps &&
+      (lastAutoDump == 0 || f - lastAutoDump > (uint32_t)dumpFrames)) {
+    lastAutoDump = f;
+    autoDumps++;
+    std::string name = hitchPrefix + "_" + std::to_string(f) + ".json";
+    dump(name.c_str());
+  }
+  return length;
+}
+
+/**
+ * Sets the frame time in milliseconds above which the recorded frames are
+ * dumped into a file starting with the given prefix. Zero turns it off.
+ */
+void FrameRecorder::setHitchDump(float thresholdMs, const char* prefix) {
+  hitchThreshold = thresholdMs > 0 ? (uint64_t)(thresholdMs * 1e6) : 0;
+  hitchPrefix = prefix;
+}
+
+/**
+ * Writes the zones of the last given number of frames from every thread into
+ * a Chrome trace JSON file. Returns false if the file cannot be written.
+ */
+bool FrameRecorder::dump(const char* fileName, int frames) {
+  std::ofstream out(fileName);
+  if (!out.is_open()) return false;
+
+  uint32_t current = getFrame();
+  uint32_t first = current > (uint32_t)frames ? current - frames : 0;
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool firstEvent = true;
+  std::vector<TraceEvent> copy(ringSize);
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  for (const auto& ring : rings) {
+    // Copy the ring, then drop the slots a write started on since then
+    uint64_t written = ring->written.load(std::memory_order_acquire);
+    uint64_t begin = written > (uint64_t)ringSize ? written - ringSize : 0;
+    for (uint64_t i = begin; i < written; i++)
+      copy[i - begin] = ring->events[i % ringSize];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t started = ring->started.load(std::memory_order_relaxed);
+    uint64_t valid = started > (uint64_t)ringSize ? started - ringSize : 0;
+    for (uint64_t i = std::max(begin, valid); i < written; i++) {
+      const TraceEvent& e = copy[i - begin];
+      if (e.frame <= first) continue;
+      if (!firstEvent) out << ",\n";
+      firstEvent = false;
+      // Chrome traces use microseconds
+      out << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1"
+          << ", \"tid\": " << ring->threadId << ", \"ts\": " << e.start / 1000.0
+          << ", \"dur\": " << e.duration / 1000.0
+          << ", \"args\": {\"frame\": " << e.frame << "}}";
+    }
+  }
+  out << "\n]}\n";
+  return out.good();
+}
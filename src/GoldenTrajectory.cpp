@@ -0,0 +1,113 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "GoldenTrajectory.h"
+
+/**
+ * Stores the state of every ball at the given step in the order of their ids.
+ */
+void GoldenTrajectory::capture(uint32_t step, const BallStore& balls) {
+  for (unsigned int id = 0; id < balls.getIdLimit(); id++) {
+    const Ball* b = balls.find(id);
+    if (b == NULL) continue;
+    GoldenSample s;
+    s.step = step;
+    s.id = id;
+    s.pos = b->getPosition();
+    s.vel = b->getVel();
+    samples.push_back(s);
+  }
+}
+
+/**
+ * Compares the trajectory with a golden one. A position or velocity matches
+ * if it differs from the golden value by at most tolerance * (1 + |golden|),
+ * so the tolerance is absolute for small values and relative for large ones.
+ * The mismatches are written into the report. Returns true if every sample
+ * matches and the same balls exist at the same steps.
+ */
+bool GoldenTrajectory::compare(const GoldenTrajectory& golden,
+                               float tolerance, std::ostream& report) const {
+  const int maxReported = 10;
+  int mismatches = 0;
+  float worst = 0;
+  auto error = [](const Vec3& v, const Vec3& g) {
+    return (v - g).len() / (1.0f + g.len());
+  };
+
+  size_t n = std::min(samples.size(), golden.samples.size());
+  for (size_t i = 0; i < n; i++) {
+    const GoldenSample& s = samples[i];
+    const GoldenSample& g = golden.samples[i];
+    if (s.step != g.step || s.id != g.id) {
+      report << "step " << g.step << ": expected ball " << g.id
+             << ", found ball " << s.id << " at step " << s.step << '\n';
+      return false;
+    }
+    float e = std::fmax(error(s.pos, g.pos), error(s.vel, g.vel));
+    worst = std::fmax(worst, e);
+    if (e <= tolerance) continue;
+    if (mismatches++ < maxReported) {
+      report << "step " << g.step << " ball " << g.id << ": pos " << s.pos.x
+             << ' ' << s.pos.y << ' ' << s.pos.z << " expected " << g.pos.x
+             << ' ' << g.pos.y << ' ' << g.pos.z << ", vel " << s.vel.x << ' '
+             << s.vel.y << ' ' << s.vel.z << " expected " << g.vel.x << ' '
+             << g.vel.y << ' ' << g.vel.z << " (error " << e << ")\n";
+    }
+  }
+  if (samples.size() != golden.samples.size()) {
+    report << samples.size() << " samples, expected "
+           << golden.samples.size() << '\n';
+    return false;
+  }
+  report << mismatches << " of " << n << " samples differ, largest error "
+         << worst << '\n';
+  return mismatches == 0;
+}
+
+/**
+ * Writes the trajectory as text, with enough digits to read back every float
+ * exactly. Returns false if the file could not be written.
+ */
+bool GoldenTrajectory::save(const char* fileName) const {
+  std::ofstream os(fileName);
+  if (!os.is_open()) return false;
+  os << "#golden 1\n#step_ms " << stepMs << '\n' << std::setprecision(9);
+  for (const GoldenSample& s : samples) {
+    os << s.step << ' ' << s.id << ' ' << s.pos.x << ' ' << s.pos.y << ' '
+       << s.pos.z << ' ' << s.vel.x << ' ' << s.vel.y << ' ' << s.vel.z
+       << '\n';
+  }
+  return os.good();
+}
+
+/**
+ * Reads a trajectory written by save. Returns false if the file could not be
+ * read or is not a golden trajectory.
+ */
+bool GoldenTrajectory::load(const char* fileName) {
+  std::ifstream is(fileName);
+  std::string line;
+  if (!std::getline(is, line) || line != "#golden 1") return false;
+  samples.clear();
+  stepMs = 0;
+  while (std::getline(is, line)) {
+    std::istringstream loader(line);
+    if (line.compare(0, 9, "#step_ms ") == 0) {
+      loader.ignore(9);
+      loader >> stepMs;
+      continue;
+    }
+    GoldenSample s;
+    loader >> s.step >> s.id >> s.pos.x >> s.pos.y >> s.pos.z >> s.vel.x >>
+        s.vel.y >> s.vel.z;
+    if (loader.fail()) return false;
+    samples.push_back(s);
+  }
+  return true;
+}
@@ -0,0 +1,87 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "HeatmapOverlay.h"
+
+/**
+ * Creates the index buffers of the levels, the OpenGL context has to exist.
+ */
+HeatmapOverlay::HeatmapOverlay() {
+  glGenBuffers(levels, elementBufferObjs);
+  for (int i = 0; i < levels; i++) indexCounts[i] = 0;
+  gpuBytes = 0;
+  visible = false;
+}
+
+/**
+ * Removes the index buffers from GPU memory.
+ */
+HeatmapOverlay::~HeatmapOverlay() {
+  glDeleteBuffers(levels, elementBufferObjs);
+  MemoryStats::add(GPU_BUFFER_MEMORY, -gpuBytes);
+}
+
+/**
+ * Sorts the triangles of the world into the levels by their test counts
+ * relative to the most tested triangle and uploads the index buffers.
+ */
+void HeatmapOverlay::update(const Mesh& world,
+                            const CollisionHeatmap& heatmap) {
+  std::vector<GLuint> lists[levels];
+  float logMax = std::log(1.0f + heatmap.getMaxTests());
+  unsigned int tNum = world.getTriangleNum();
+  for (unsigned int i = 0; i < tNum; i++) {
+    uint32_t tests = i < heatmap.getTriangleNum() ? heatmap.getTests(i) : 0;
+    int level = 0;
+    if (tests > 0 && logMax > 0) {
+      level = 1 + (int)((levels - 1) * std::log(1.0f + tests) / logMax);
+      if (level >= levels) level = levels - 1;
+    }
+    unsigned int a, b, c;
+    world.getTriangleIdx(i, &a, &b, &c);
+    lists[level].push_back(a);
+    lists[level].push_back(b);
+    lists[level].push_back(c);
+  }
+
+  for (int i = 0; i < levels; i++) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObjs[i]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * lists[i].size(),
+                 lists[i].data(), GL_DYNAMIC_DRAW);
+    indexCounts[i] = lists[i].size();
+  }
+  int64_t bytes = sizeof(GLuint) * 3 * tNum;
+  MemoryStats::add(GPU_BUFFER_MEMORY, bytes - gpuBytes);
+  gpuBytes = bytes;
+}
+
+/**
+ * Renders the world with the colors of the levels: grey for untested
+ * triangles, then from blue through green and yellow to red for the most
+ * expensive ones.
+ */
+void HeatmapOverlay::render(const Model& world, GLint posAttrib,
+                            GLint colorLocation) const {
+  world.bindBuffers();
+  glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  for (int i = 0; i < levels; i++) {
+    if (indexCounts[i] == 0) continue;
+    if (i == 0) {
+      glUniform4f(colorLocation, 0.75f, 0.75f, 0.75f, 1.0f);
+    } else {
+      // Blue at the first level, red at the last one
+      float t = (float)(i - 1) / (levels - 2);
+      glUniform4f(colorLocation, std::fmin(1.0f, 2.0f * t),
+                  std::fmin(1.0f, 2.0f - 2.0f * t) * std::fmin(1.0f, 3.0f * t),
+                  std::fmax(0.0f, 1.0f - 3.0f * t), 1.0f);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObjs[i]);
+    glDrawElements(GL_TRIANGLES, indexCounts[i], GL_UNSIGNED_INT, 0);
+    Model::addDrawCalls(1);
+  }
+}
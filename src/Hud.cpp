@@ -0,0 +1,219 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "Hud.h"
+
+namespace {
+/**
+ * The segments of the font, each given by its two end points inside a 1 wide
+ * and 2 tall character cell. The names are the ones used by the usual
+ * 14-segment displays, with 'G' as the right half of the middle bar and
+ * 'p', 'q', 'r' as dots for punctuation.
+ */
+struct Segment {
+  char name;
+  float x1, y1, x2, y2;
+};
+const Segment segments[] = {
+    {'a', 0, 2, 1, 2},         {'b', 1, 2, 1, 1},     {'c', 1, 1, 1, 0},
+    {'d', 0, 0, 1, 0},         {'e', 0, 0, 0, 1},     {'f', 0, 1, 0, 2},
+    {'g', 0, 1, 0.5f, 1},      {'G', 0.5f, 1, 1, 1},  {'h', 0, 2, 0.5f, 1},
+    {'i', 0.5f, 2, 0.5f, 1},   {'j', 1, 2, 0.5f, 1},  {'k', 0, 0, 0.5f, 1},
+    {'l', 0.5f, 0, 0.5f, 1},   {'m', 1, 0, 0.5f, 1},
+    {'p', 0.4f, 0, 0.6f, 0},   {'q', 0.4f, 1.5f, 0.6f, 1.5f},
+    {'r', 0.4f, 0.5f, 0.6f, 0.5f}};
+
+/**
+ * Returns the segments that make up the given character.
+ */
+const char* glyph(char c) {
+  switch (c) {
+    case '0': return "abcdef";
+    case '1': return "bc";
+    case '2': return "abgGed";
+    case '3': return "abcdG";
+    case '4': return "fgGbc";
+    case '5': case 'S': return "afgGcd";
+    case '6': return "afgGcde";
+    case '7': return "abc";
+    case '8': return "abcdefgG";
+    case '9': return "abcdfgG";
+    case '.': return "p";
+    case ':': return "qr";
+    case '/': return "jk";
+    case '-': return "gG";
+    case 'A': return "abcefgG";
+    case 'B': return "abcdiGl";
+    case 'C': return "adef";
+    case 'D': return "abcdil";
+    case 'E': return "adefg";
+    case 'F': return "aefg";
+    case 'G': return "acdefG";
+    case 'H': return "bcefgG";
+    case 'I': return "adil";
+    case 'J': return "bcde";
+    case 'K': return "efgjm";
+    case 'L': return "def";
+    case 'M': return "bcefhj";
+    case 'N': return "bcefhm";
+    case 'O': return "abcdef";
+    case 'P': return "abefgG";
+    case 'Q': return "abcdefm";
+    case 'R': return "abefgGm";
+    case 'T': return "ail";
+    case 'U': return "bcdef";
+    case 'V': return "efjk";
+    case 'W': return "bcefkm";
+    case 'X': return "hjkm";
+    case 'Y': return "hjl";
+    case 'Z': return "adjk";
+    default: return "";
+  }
+}
+}  // namespace
+
+/**
+ * Creates the vertex buffer of the overlay, the OpenGL context has to exist.
+ */
+Hud::Hud() {
+  glGenBuffers(1, &vertexBufferObj);
+  for (int i = 0; i < historySize; i++) frameHistory[i] = stepHistory[i] = 0;
+  historyPos = 0;
+  visible = false;
+}
+
+/**
+ * Removes the vertex buffer from GPU memory.
+ */
+Hud::~Hud() { glDeleteBuffers(1, &vertexBufferObj); }
+
+/**
+ * Stores the times of the last frame for the rolling graphs.
+ */
+void Hud::addSample(float frameMs, float stepMs) {
+  frameHistory[historyPos] = frameMs;
+  stepHistory[historyPos] = stepMs;
+  historyPos = (historyPos + 1) % historySize;
+}
+
+/**
+ * Appends a line given in pixel coordinates.
+ */
+void Hud::addLine(float x1, float y1, float x2, float y2) {
+  GLfloat vs[] = {x1, y1, 0, x2, y2, 0};
+  lines.insert(lines.end(), vs, vs + 6);
+}
+
+/**
+ * Appends the lines of a string starting at the given bottom left corner. The
+ * size is the width of a character in pixels.
+ */
+void Hud::addText(float x, float y, float size, const char* str) {
+  for (; *str != '\0'; str++, x += size * 1.6f) {
+    char c = (*str >= 'a' && *str <= 'z') ? *str - 'a' + 'A' : *str;
+    for (const char* s = glyph(c); *s != '\0'; s++) {
+      for (const Segment& seg : segments) {
+        if (seg.name != *s) continue;
+        addLine(x + seg.x1 * size, y + seg.y1 * size, x + seg.x2 * size,
+                y + seg.y2 * size);
+      }
+    }
+  }
+}
+
+/**
+ * Appends a line graph of the history samples (oldest first) inside the given
+ * box, with the given value at the top.
+ */
+void Hud::addGraph(float x, float y, float w, float h, const float* samples,
+                   float maxValue) {
+  float dx = w / (historySize - 1);
+  for (int i = 0; i + 1 < historySize; i++) {
+    float v1 = samples[(historyPos + i) % historySize] / maxValue;
+    float v2 = samples[(historyPos + i + 1) % historySize] / maxValue;
+    addLine(x + i * dx, y + h * std::fmin(v1, 1.0f), x + (i + 1) * dx,
+            y + h * std::fmin(v2, 1.0f));
+  }
+}
+
+/**
+ * Uploads the lines from the given vertex offset and draws them in one call.
+ */
+void Hud::drawLines(GLint posAttrib, GLint colorLocation, size_t from,
+                    float r, float g, float b) {
+  if (lines.size() <= from) return;
+  glUniform4f(colorLocation, r, g, b, 1.0f);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * (lines.size() - from),
+               lines.data() + from, GL_STREAM_DRAW);
+  glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  glDrawArrays(GL_LINES, 0, (lines.size() - from) / 3);
+}
+
+/**
+ * Draws the overlay on top of the scene if it is visible.
+ */
+void Hud::render(GLint posAttrib, GLint colorLocation,
+                 GLint projectionLocation, GLint modelViewLocation, int width,
+                 int height, const HudStats& stats) {
+  if (!visible) return;
+
+  // Draw in pixel coordinates on top of everything
+  Matrix proj = Matrix::orthographic(0, width, 0, height, -1, 1);
+  Matrix identity;
+  glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, proj.getElements());
+  glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, identity.getElements());
+  glDisable(GL_DEPTH_TEST);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObj);
+
+  // The counters
+  lines.clear();
+  char buf[64];
+  float size = 7.0f, lineHeight = 22.0f;
+  float x = 12.0f, y = height - 12.0f - 2 * size;
+  auto counter = [&](const char* label, double value, const char* format) {
+    snprintf(buf, sizeof(buf), format, label, value);
+    addText(x, y, size, buf);
+    y -= lineHeight;
+  };
+  counter("FRAME MS", stats.frameMs, "%-11s %.2f");
+  counter("STEP MS", stats.stepMs, "%-11s %.2f");
+  counter("BALLS", stats.balls, "%-11s %.0f");
+  counter("AWAKE", stats.awakeBalls, "%-11s %.0f");
+  counter("PAIRS", stats.pairTests, "%-11s %.0f");
+  counter("TRI TESTS", stats.triangleTests, "%-11s %.0f");
+  counter("REBUILDS", stats.cacheRebuilds, "%-11s %.0f");
+  counter("CONTACTS", stats.contacts, "%-11s %.0f");
+  counter("RESOLVED", stats.resolved, "%-11s %.0f");
+  counter("DRAW CALLS", stats.drawCalls, "%-11s %.0f");
+  counter("SWAP MS", stats.swapMs, "%-11s %.2f");
+  counter("INPUT MS", stats.inputMs, "%-11s %.2f");
+  counter("INPUT P50", stats.inputP50Ms, "%-11s %.2f");
+  counter("INPUT P99", stats.inputP99Ms, "%-11s %.2f");
+  counter("MEMORY MB", stats.memoryMb, "%-11s %.2f");
+  counter("MEM PEAK MB", stats.memoryPeakMb, "%-11s %.2f");
+  if (stats.loadPercent >= 0)
+    counter("LOADING", stats.loadPercent, "%-11s %.0f");
+  drawLines(posAttrib, colorLocation, 0, 0.95f, 0.95f, 0.95f);
+
+  // The rolling graphs, the top of both is 33 ms (two frames at 60 fps)
+  float gx = x, gw = 3.0f * historySize / 2, gh = 60.0f;
+  float gy = y - gh;
+  lines.clear();
+  addLine(gx, gy, gx + gw, gy);
+  addLine(gx, gy + gh / 2, gx + gw, gy + gh / 2);  // 16.7 ms
+  addLine(gx, gy + gh, gx + gw, gy + gh);
+  drawLines(posAttrib, colorLocation, 0, 0.4f, 0.4f, 0.4f);
+  lines.clear();
+  addGraph(gx, gy, gw, gh, frameHistory, 33.3f);
+  drawLines(posAttrib, colorLocation, 0, 0.3f, 0.9f, 0.3f);
+  lines.clear();
+  addGraph(gx, gy, gw, gh, stepHistory, 33.3f);
+  drawLines(posAttrib, colorLocation, 0, 0.95f, 0.6f, 0.2f);
+
+  glEnable(GL_DEPTH_TEST);
+}
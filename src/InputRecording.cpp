@@ -0,0 +1,361 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "InputRecording.h"
+
+#include <algorithm>
+
+namespace {
+const char magic[4] = {'M', 'R', 'I', 'N'};
+
+/**
+ * Writes a value in its in-memory representation.
+ */
+template <typename T>
+void writeRaw(std::ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * Reads a value written by writeRaw.
+ */
+template <typename T>
+void readRaw(std::istream& is, T& value) {
+  is.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+/**
+ * Writes an unsigned integer in 7 bit groups, small numbers take a byte.
+ */
+void writeVarint(std::ostream& os, uint32_t value) {
+  while (value >= 0x80) {
+    os.put((char)((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  os.put((char)value);
+}
+
+/**
+ * Reads an unsigned integer written by writeVarint.
+ */
+uint32_t readVarint(std::istream& is) {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int c = is.get();
+    if (c == EOF) break;
+    value |= (uint32_t)(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) break;
+  }
+  return value;
+}
+
+/**
+ * Writes the coordinates of a vector.
+ */
+void writeVec3(std::ostream& os, const Vec3& v) {
+  writeRaw(os, v.x);
+  writeRaw(os, v.y);
+  writeRaw(os, v.z);
+}
+
+/**
+ * Reads the coordinates of a vector.
+ */
+void readVec3(std::istream& is, Vec3& v) {
+  readRaw(is, v.x);
+  readRaw(is, v.y);
+  readRaw(is, v.z);
+}
+
+/**
+ * Writes a string prefixed with its length.
+ */
+void writeString(std::ostream& os, const std::string& s) {
+  writeVarint(os, s.size());
+  os.write(s.data(), s.size());
+}
+
+/**
+ * Returns the number of bytes left in the stream before the given end, or 0
+ * if the stream failed.
+ */
+uint64_t bytesLeft(std::istream& is, uint64_t end) {
+  std::streamoff pos = is.tellg();
+  if (!is || pos < 0 || (uint64_t)pos > end) return 0;
+  return end - pos;
+}
+
+/**
+ * Reads a string written by writeString into a stream ending at the given
+ * position. A length past the end fails the stream instead of allocating it.
+ */
+void readString(std::istream& is, std::string& s, uint64_t end) {
+  uint32_t size = readVarint(is);
+  if (size > bytesLeft(is, end)) {
+    is.setstate(std::ios::failbit);
+    return;
+  }
+  s.resize(size);
+  is.read(&s[0], s.size());
+}
+}  // namespace
+
+/**
+ * Initialises an event of the given type with default ball settings.
+ */
+InputEvent::InputEvent(InputEventType type_, uint32_t frame_)
+    : frame(frame_), type(type_) {
+  radius = 5.0f;
+  bounciness = 0.15f;
+  friction = 0.3f;
+  pattern = STREAM_EMITTER;
+  count = 0;
+  rate = 0.0f;
+  seed = 1;
+  flag = false;
+}
+
+/**
+ * Stores the position, velocity and settings of a ball in the event.
+ */
+void InputEvent::setBall(const Ball& b) {
+  pos = b.getPosition();
+  vel = b.getVel();
+  radius = b.getRadius();
+  bounciness = b.getBounciness();
+  friction = b.getFrictionCoefficient();
+}
+
+/**
+ * Returns the ball stored in the event.
+ */
+Ball InputEvent::makeBall() const {
+  Ball b(pos, radius);
+  b.setVel(vel);
+  b.setBounciness(bounciness);
+  b.setFrictionCoefficient(friction);
+  return b;
+}
+
+/**
+ * Returns the emitter described by an emitter start event, ready to start.
+ */
+BallEmitter InputEvent::makeEmitter() const {
+  BallEmitter emitter(pattern, count, rate, makeBall());
+  emitter.setBox(boxMin, boxMax);
+  emitter.setSeed(seed);
+  return emitter;
+}
+
+/**
+ * Initialises an empty recording.
+ */
+InputRecording::InputRecording() {
+  dt = 1.0f / 60.0f;
+  frameCount = 0;
+  startStopped = false;
+  cursor = 0;
+}
+
+/**
+ * Replaces the geometry of a mesh with a copy of another one.
+ */
+void InputRecording::copyMesh(const Mesh& from, Mesh& to) {
+  to.releaseArrays();
+  to.vertices = new float[from.vCount];
+  to.indices = new unsigned int[from.iCount];
+  std::copy(from.vertices, from.vertices + from.vCount, to.vertices);
+  std::copy(from.indices, from.indices + from.iCount, to.indices);
+  to.vCount = from.vCount;
+  to.iCount = from.iCount;
+  to.setAccountedBytes(sizeof(float) * to.vCount +
+                       sizeof(unsigned int) * to.iCount);
+}
+
+/**
+ * Clears the recording and stores the state of the simulation it starts
+ * from. The simulation itself is not changed.
+ */
+void InputRecording::start(const Simulation& sim, float dt_, bool stopped) {
+  copyMesh(sim.getWorld(), startWorld);
+  startState.capture(sim);
+  dt = dt_;
+  startStopped = stopped;
+  frameCount = 0;
+  events.clear();
+  cursor = 0;
+}
+
+/**
+ * Puts the simulation into the state the recording starts from, replacing
+ * its world geometry.
+ */
+void InputRecording::restore(Simulation& sim) const {
+  copyMesh(startWorld, sim.getWorld());
+  startState.restore(sim);
+  sim.updateWorldBounds();
+}
+
+/**
+ * Returns the next event that happened in or before the given frame, or NULL
+ * if every event of the frame has already been replayed.
+ */
+const InputEvent* InputRecording::next(uint32_t frame) {
+  if (cursor >= events.size() || events[cursor].frame > frame) return NULL;
+  return &events[cursor++];
+}
+
+/**
+ * Writes the recording into a binary file. Every event starts with the
+ * number of frames since the previous event and its type, followed by only
+ * the fields its type uses. Returns false if the file could not be written.
+ */
+bool InputRecording::save(const char* fileName) const {
+  std::ofstream os(fileName, std::ios::binary);
+  if (!os.is_open()) return false;
+  os.write(magic, sizeof(magic));
+  writeRaw(os, version);
+  writeRaw(os, dt);
+  writeRaw(os, frameCount);
+  os.put(startStopped ? 1 : 0);
+  writeRaw(os, startWorld.vCount);
+  writeRaw(os, startWorld.iCount);
+  os.write((const char*)startWorld.vertices, sizeof(float) * startWorld.vCount);
+  os.write((const char*)startWorld.indices,
+           sizeof(unsigned int) * startWorld.iCount);
+  if (!startState.save(os)) return false;
+  writeVarint(os, events.size());
+
+  uint32_t lastFrame = 0;
+  for (const InputEvent& e : events) {
+    writeVarint(os, e.frame - lastFrame);
+    lastFrame = e.frame;
+    os.put((char)e.type);
+    switch (e.type) {
+      case CAMERA_INPUT:
+      case EMITTER_STREAM_INPUT:
+        writeVec3(os, e.pos);
+        writeVec3(os, e.vel);
+        break;
+      case PLACE_BALL_INPUT:
+        writeVec3(os, e.pos);
+        writeVec3(os, e.vel);
+        writeRaw(os, e.radius);
+        writeRaw(os, e.bounciness);
+        writeRaw(os, e.friction);
+        break;
+      case TIME_STOP_INPUT:
+        os.put(e.flag ? 1 : 0);
+        break;
+      case EMITTER_START_INPUT:
+        os.put((char)e.pattern);
+        writeRaw(os, e.count);
+        writeRaw(os, e.rate);
+        writeRaw(os, e.radius);
+        writeRaw(os, e.bounciness);
+        writeRaw(os, e.friction);
+        writeVec3(os, e.boxMin);
+        writeVec3(os, e.boxMax);
+        writeRaw(os, e.seed);
+        break;
+      case LOAD_SCENE_INPUT:
+        writeString(os, e.path);
+        break;
+      default:
+        break;
+    }
+  }
+  return os.good();
+}
+
+/**
+ * Reads a recording written by save. Returns false if the file could not be
+ * read, is not a recording of this version or is corrupt.
+ */
+bool InputRecording::load(const char* fileName) {
+  std::ifstream is(fileName, std::ios::binary | std::ios::ate);
+  if (!is.is_open()) return false;
+  uint64_t end = is.tellg();
+  is.seekg(0);
+  char m[4];
+  uint32_t v = 0;
+  is.read(m, sizeof(m));
+  readRaw(is, v);
+  if (!is || std::string(m, 4) != std::string(magic, 4) || v != version)
+    return false;
+  readRaw(is, dt);
+  readRaw(is, frameCount);
+  startStopped = is.get() == 1;
+  // The arrays are only allocated if the file is long enough to hold them
+  uint32_t vCount = 0, iCount = 0;
+  readRaw(is, vCount);
+  readRaw(is, iCount);
+  if (sizeof(float) * (uint64_t)vCount +
+          sizeof(unsigned int) * (uint64_t)iCount >
+      bytesLeft(is, end))
+    return false;
+  startWorld.releaseArrays();
+  startWorld.vertices = new float[vCount];
+  startWorld.indices = new unsigned int[iCount];
+  startWorld.vCount = vCount;
+  startWorld.iCount = iCount;
+  startWorld.setAccountedBytes(sizeof(float) * vCount +
+                               sizeof(unsigned int) * iCount);
+  is.read((char*)startWorld.vertices, sizeof(float) * vCount);
+  is.read((char*)startWorld.indices, sizeof(unsigned int) * iCount);
+  if (!is || !startState.load(is, end)) return false;
+
+  events.clear();
+  cursor = 0;
+  uint32_t eventNum = readVarint(is);
+  uint32_t frame = 0;
+  for (uint32_t i = 0; i < eventNum && is; i++) {
+    frame += readVarint(is);
+    int type = is.get();
+    if (type < 0 || type >= INPUT_EVENT_TYPES) return false;
+    InputEvent e((InputEventType)type, frame);
+    switch (e.type) {
+      case CAMERA_INPUT:
+      case EMITTER_STREAM_INPUT:
+        readVec3(is, e.pos);
+        readVec3(is, e.vel);
+        break;
+      case PLACE_BALL_INPUT:
+        readVec3(is, e.pos);
+        readVec3(is, e.vel);
+        readRaw(is, e.radius);
+        readRaw(is, e.bounciness);
+        readRaw(is, e.friction);
+        break;
+      case TIME_STOP_INPUT:
+        e.flag = is.get() == 1;
+        break;
+      case EMITTER_START_INPUT: {
+        int pattern = is.get();
+        if (pattern < 0 || pattern >= EMITTER_PATTERNS) return false;
+        e.pattern = (EmitterPattern)pattern;
+        readRaw(is, e.count);
+        readRaw(is, e.rate);
+        readRaw(is, e.radius);
+        readRaw(is, e.bounciness);
+        readRaw(is, e.friction);
+        readVec3(is, e.boxMin);
+        readVec3(is, e.boxMax);
+        readRaw(is, e.seed);
+        break;
+      }
+      case LOAD_SCENE_INPUT:
+        readString(is, e.path, end);
+        break;
+      default:
+        break;
+    }
+    events.push_back(e);
+  }
+  return !is.fail();
+}
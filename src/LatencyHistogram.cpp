@@ -0,0 +1,96 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "LatencyHistogram.h"
+
+/**
+ * Initialises an empty histogram.
+ */
+LatencyHistogram::LatencyHistogram() { reset(); }
+
+/**
+ * Removes every recorded value.
+ */
+void LatencyHistogram::reset() {
+  for (int i = 0; i < bucketCount; i++) counts[i] = 0;
+  count = 0;
+  minValue = UINT64_MAX;
+  maxValue = 0;
+  sum = 0;
+}
+
+/**
+ * Returns the index of the bucket the value belongs to. Values below
+ * subBuckets have a bucket each, above that the top subBucketBits bits after
+ * the leading one select the bucket inside the range of the leading bit.
+ */
+int LatencyHistogram::bucketOf(uint64_t value) {
+  if (value < (uint64_t)subBuckets) return (int)value;
+  int top = 63;
+  while ((value >> top) == 0) top--;
+  int shift = top - subBucketBits;
+  int range = shift + 1;
+  return range * subBuckets + (int)((value >> shift) - subBuckets);
+}
+
+/**
+ * Returns the value in the middle of the given bucket.
+ */
+uint64_t LatencyHistogram::bucketMidpoint(int bucket) {
+  if (bucket < subBuckets) return bucket;
+  int shift = bucket / subBuckets - 1;
+  uint64_t low = (uint64_t)(bucket % subBuckets + subBuckets) << shift;
+  return low + ((uint64_t)1 << shift) / 2;
+}
+
+/**
+ * Adds a value to the histogram.
+ */
+void LatencyHistogram::record(uint64_t value) {
+  counts[bucketOf(value)]++;
+  count++;
+  if (value < minValue) minValue = value;
+  if (value > maxValue) maxValue = value;
+  sum += value;
+}
+
+/**
+ * Returns the value below which the given percent of the recorded values are,
+ * accurate to the width of a bucket. The largest bucket is clamped to the
+ * maximum so p100 is exact.
+ */
+uint64_t LatencyHistogram::getPercentile(double percentile) const {
+  if (count == 0) return 0;
+  uint64_t rank = (uint64_t)(percentile / 100.0 * count + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > count) rank = count;
+  uint64_t seen = 0;
+  for (int i = 0; i < bucketCount; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint64_t v = bucketMidpoint(i);
+      return v > maxValue ? maxValue : (v < minValue ? minValue : v);
+    }
+  }
+  return maxValue;
+}
+
+/**
+ * Writes the count, mean, extremes and the usual percentiles as a JSON object,
+ * with the values divided by the unit (nanoseconds to milliseconds by
+ * default).
+ */
+void LatencyHistogram::writeSummary(std::ostream& os, double unit) const {
+  os << "{\"count\":" << count << ",\"mean\":" << getMean() / unit
+     << ",\"min\":" << getMin() / unit
+     << ",\"p50\":" << getPercentile(50) / unit
+     << ",\"p90\":" << getPercentile(90) / unit
+     << ",\"p99\":" << getPercentile(99) / unit
+     << ",\"p99.9\":" << getPercentile(99.9) / unit
+     << ",\"max\":" << getMax() / unit << '}';
+}
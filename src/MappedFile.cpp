@@ -0,0 +1,78 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "MappedFile.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Initialises an empty mapping.
+ */
+MappedFile::MappedFile() : data(NULL), size(0), mapped(false) {}
+
+/**
+ * Unmaps the file.
+ */
+MappedFile::~MappedFile() { close(); }
+
+/**
+ * Maps the given file into memory, replacing the previously mapped one.
+ * Returns false if the file could not be read.
+ */
+bool MappedFile::open(const char* fileName) {
+  close();
+#ifndef _WIN32
+  int fd = ::open(fileName, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                   0);
+    if (p != MAP_FAILED) {
+      data = (char*)p;
+      size = st.st_size;
+      mapped = true;
+    }
+  }
+  ::close(fd);
+  if (mapped) return true;
+#endif
+  // Fall back to reading the whole file
+  std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) return false;
+  std::streamoff length = file.tellg();
+  if (length < 0) return false;
+  file.seekg(0);
+  data = new char[length];
+  size = length;
+  if (!file.read(data, length)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Unmaps the file or frees the buffer it was read into.
+ */
+void MappedFile::close() {
+#ifndef _WIN32
+  if (mapped) munmap(data, size);
+#endif
+  if (!mapped) delete[] data;
+  data = NULL;
+  size = 0;
+  mapped = false;
+}
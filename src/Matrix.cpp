@@ -213,3 +213,19 @@ Matrix Matrix::perspective(float fov, float aspectRatio, float zNear,
   xmax = ymax * aspectRatio;
   return Matrix::frustum(-xmax, xmax, -ymax, ymax, zNear, zFar);
 }
+
+/**
+ * Returns an orthographic projection matrix mapping the given box to the
+ * normalized device coordinates. Used for drawing overlays in screen space.
+ */
+Matrix Matrix::orthographic(float left, float right, float bottom, float top,
+                            float zNear, float zFar) {
+  Matrix ret;
+  ret.m[0] = 2.0f / (right - left);
+  ret.m[5] = 2.0f / (top - bottom);
+  ret.m[10] = -2.0f / (zFar - zNear);
+  ret.m[12] = -(right + left) / (right - left);
+  ret.m[13] = -(top + bottom) / (top - bottom);
+  ret.m[14] = -(zFar + zNear) / (zFar - zNear);
+  return ret;
+}
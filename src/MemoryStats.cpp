@@ -0,0 +1,83 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "MemoryStats.h"
+
+#include <iomanip>
+
+std::atomic<int64_t> MemoryStats::current[MEMORY_CATEGORY_COUNT];
+std::atomic<int64_t> MemoryStats::peak[MEMORY_CATEGORY_COUNT];
+std::atomic<int64_t> MemoryStats::total(0);
+std::atomic<int64_t> MemoryStats::totalPeak(0);
+
+/**
+ * Raises the peak to the given value if it is higher.
+ */
+void MemoryStats::raisePeak(std::atomic<int64_t>& p, int64_t value) {
+  int64_t old = p.load(std::memory_order_relaxed);
+  while (value > old &&
+         !p.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+}
+
+/**
+ * Adds the given number of bytes to a category, negative values are freed
+ * bytes.
+ */
+void MemoryStats::add(MemoryCategory c, int64_t bytes) {
+  if (bytes == 0) return;
+  raisePeak(peak[c], current[c].fetch_add(bytes) + bytes);
+  raisePeak(totalPeak, total.fetch_add(bytes) + bytes);
+}
+
+/**
+ * Sets the bytes of a category, for the ones that are measured by walking
+ * the data instead of tracking every allocation.
+ */
+void MemoryStats::set(MemoryCategory c, int64_t bytes) {
+  add(c, bytes - current[c].load(std::memory_order_relaxed));
+}
+
+/**
+ * Returns the name of a category used in the reports.
+ */
+const char* MemoryStats::getName(MemoryCategory c) {
+  static const char* const names[MEMORY_CATEGORY_COUNT] = {
+      "CPU mesh", "GPU buffers", "balls", "ball caches", "contacts",
+      "heatmap", "scene saving", "snapshots", "scene cache"};
+  return names[c];
+}
+
+/**
+ * Restarts the peaks from the current values, e.g. when a new scene is loaded.
+ */
+void MemoryStats::resetPeaks() {
+  for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    peak[i].store(current[i].load(std::memory_order_relaxed));
+  totalPeak.store(total.load(std::memory_order_relaxed));
+}
+
+/**
+ * Writes the current and peak size of every category in KiB.
+ */
+void MemoryStats::print(std::ostream& os) {
+  std::ios::fmtflags flags = os.flags();
+  std::streamsize precision = os.precision();
+  os << std::fixed << std::setprecision(1);
+  for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+    MemoryCategory c = (MemoryCategory)i;
+    os << std::left << std::setw(12) << getName(c) << std::right
+       << std::setw(10) << getCurrent(c) / 1024.0 << " KiB, peak "
+       << std::setw(10) << getPeak(c) / 1024.0 << " KiB\n";
+  }
+  os << std::left << std::setw(12) << "total" << std::right << std::setw(10)
+     << getTotal() / 1024.0 << " KiB, peak " << std::setw(10)
+     << getTotalPeak() / 1024.0 << " KiB\n";
+  os.flags(flags);
+  os.precision(precision);
+}
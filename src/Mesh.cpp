@@ -0,0 +1,153 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "Mesh.h"
+
+#include <atomic>
+#include <utility>
+
+#include "SceneParser.h"
+
+namespace {
+
+// The source of the mesh revisions, so two meshes never share one
+std::atomic<uint64_t> lastRevision(0);
+
+}  // namespace
+
+/**
+ * Initalises an empty mesh.
+ */
+Mesh::Mesh() {
+  // Initalise vertex and index array pointers as NULL
+  vertices = NULL;
+  vCount = 0;
+  indices = NULL;
+  iCount = 0;
+  accountedBytes = 0;
+  mapping = NULL;
+  revision = 0;
+}
+
+/**
+ * Frees the loaded memory.
+ */
+Mesh::~Mesh() { releaseArrays(); }
+
+/**
+ * Frees the vertex and index arrays, or the mapped file containing them. The
+ * mesh gets a new revision, as every new geometry is loaded after this.
+ */
+void Mesh::releaseArrays() {
+  if (mapping != NULL) {
+    delete mapping;
+    mapping = NULL;
+  } else {
+    delete[] vertices;
+    delete[] indices;
+  }
+  vertices = NULL;
+  indices = NULL;
+  vCount = iCount = 0;
+  setAccountedBytes(0);
+  revision = ++lastRevision;
+}
+
+/**
+ * Gives the mesh a new revision after its arrays were changed in place.
+ */
+void Mesh::touch() { revision = ++lastRevision; }
+
+/**
+ * Reports the new size of the vertex and index arrays to the memory
+ * accounting.
+ */
+void Mesh::setAccountedBytes(int64_t bytes) {
+  MemoryStats::add(MESH_MEMORY, bytes - accountedBytes);
+  accountedBytes = bytes;
+}
+
+/**
+ * Exchanges the geometry of the two meshes.
+ */
+void Mesh::swap(Mesh& other) {
+  std::swap(vertices, other.vertices);
+  std::swap(vCount, other.vCount);
+  std::swap(indices, other.indices);
+  std::swap(iCount, other.iCount);
+  std::swap(accountedBytes, other.accountedBytes);
+  std::swap(mapping, other.mapping);
+  std::swap(revision, other.revision);
+}
+
+/**
+ * Returns the number of vertices in the mesh.
+ */
+unsigned int Mesh::getVertexNum() const { return vCount / 3; }
+
+/**
+ * Returns the vertex at the given index as a Vec3.
+ */
+Vec3 Mesh::getVertex(unsigned int index) const {
+  return Vec3(vertices[index * 3], vertices[index * 3 + 1],
+              vertices[index * 3 + 2]);
+}
+
+/**
+ * Returns the number of triangles in the mesh.
+ */
+unsigned int Mesh::getTriangleNum() const { return iCount / 3; }
+
+/**
+ * Loads the requested triangle's vertices into the Vec3 pointers.
+ */
+void Mesh::getTriangle(unsigned int index, Vec3* a, Vec3* b, Vec3* c) const {
+  (*a) = getVertex(indices[index * 3]);
+  (*b) = getVertex(indices[index * 3 + 1]);
+  (*c) = getVertex(indices[index * 3 + 2]);
+}
+
+/**
+ * Loads the requested triangle's vertex indices into the pointers.
+ */
+void Mesh::getTriangleIdx(unsigned int index, unsigned int* a,
+                          unsigned int* b, unsigned int* c) const {
+  (*a) = (indices[index * 3]);
+  (*b) = (indices[index * 3 + 1]);
+  (*c) = (indices[index * 3 + 2]);
+}
+
+/**
+ * Loads the corners of the axis aligned bounding box of the mesh into the
+ * pointers. Returns false if the mesh has no vertices.
+ */
+bool Mesh::getBounds(Vec3* min, Vec3* max) const {
+  unsigned int vNum = getVertexNum();
+  if (vNum == 0) return false;
+  (*min) = (*max) = getVertex(0);
+  for (unsigned int i = 1; i < vNum; i++) {
+    Vec3 v = getVertex(i);
+    min->x = std::fmin(min->x, v.x);
+    min->y = std::fmin(min->y, v.y);
+    min->z = std::fmin(min->z, v.z);
+    max->x = std::fmax(max->x, v.x);
+    max->y = std::fmax(max->y, v.y);
+    max->z = std::fmax(max->z, v.z);
+  }
+  return true;
+}
+
+/**
+ * Reads the obj file from an input stream.
+ */
+std::istream& operator>>(std::istream& is, Mesh& mesh) {
+  std::string buffer;
+  SceneParser::readAll(is, buffer);
+  SceneParser::parseObj(buffer.data(), buffer.data() + buffer.size(), mesh);
+  return is;
+}
@@ -0,0 +1,179 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "MeshPatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/**
+ * Appends the element at i to the ranges, extending the last range if it is
+ * at most gap elements before it.
+ */
+inline void addElement(std::vector<MeshRange>& ranges, unsigned int i,
+                       unsigned int gap) {
+  if (!ranges.empty()) {
+    MeshRange& last = ranges.back();
+    if (last.first + last.count + gap >= i) {
+      last.count = i + 1 - last.first;
+      return;
+    }
+  }
+  ranges.push_back({i, 1});
+}
+
+/**
+ * Finds the elements of b that differ from a, including the ones past the
+ * end of a, as ranges merged over the given gap.
+ */
+template <typename T>
+void diffArrays(const T* a, unsigned int aCount, const T* b,
+                unsigned int bCount, unsigned int gap,
+                std::vector<MeshRange>& ranges) {
+  ranges.clear();
+  unsigned int common = std::min(aCount, bCount);
+  for (unsigned int i = 0; i < common; i++)
+    if (a[i] != b[i]) addElement(ranges, i, gap);
+  if (bCount > common) {
+    addElement(ranges, common, gap);
+    ranges.back().count = bCount - ranges.back().first;
+  }
+}
+
+}  // namespace
+
+/**
+ * Initialises an empty patch.
+ */
+MeshPatch::MeshPatch()
+    : vertexResized(false),
+      indexResized(false),
+      changed(false),
+      bounded(false) {}
+
+/**
+ * Extends the box of the patch with a point.
+ */
+void MeshPatch::extend(const Vec3& v) {
+  if (!bounded) {
+    min = max = v;
+    bounded = true;
+  }
+  min = Vec3(std::fmin(min.x, v.x), std::fmin(min.y, v.y),
+             std::fmin(min.z, v.z));
+  max = Vec3(std::fmax(max.x, v.x), std::fmax(max.y, v.y),
+             std::fmax(max.z, v.z));
+}
+
+/**
+ * Extends the box of the patch with the triangles of the mesh that use a
+ * moved vertex, lie in one of the changed index ranges or are missing from
+ * the other version of the mesh.
+ */
+void MeshPatch::addTriangles(const Mesh& mesh,
+                             const std::vector<bool>& movedVertices,
+                             const std::vector<MeshRange>& ranges,
+                             unsigned int commonIndices) {
+  unsigned int vNum = mesh.getVertexNum();
+  size_t r = 0;
+  for (unsigned int e = 0; e + 3 <= mesh.iCount; e += 3) {
+    while (r < ranges.size() && ranges[r].first + ranges[r].count <= e) r++;
+    bool hit = e + 3 > commonIndices ||
+               (r < ranges.size() && ranges[r].first < e + 3);
+    const unsigned int* corner = mesh.indices + e;
+    for (int k = 0; k < 3 && !hit; k++)
+      hit = corner[k] < movedVertices.size() && movedVertices[corner[k]];
+    if (!hit) continue;
+    for (int k = 0; k < 3; k++)
+      if (corner[k] < vNum) extend(mesh.getVertex(corner[k]));
+  }
+}
+
+/**
+ * Finds the differences between the current and the next version of a mesh.
+ */
+void MeshPatch::compute(const Mesh& current, const Mesh& next) {
+  vertexResized = current.vCount != next.vCount;
+  indexResized = current.iCount != next.iCount;
+  bounded = false;
+
+  // The vertices that moved, appeared or disappeared
+  unsigned int curVNum = current.getVertexNum();
+  unsigned int nextVNum = next.getVertexNum();
+  unsigned int commonVNum = std::min(curVNum, nextVNum);
+  std::vector<bool> moved(std::max(curVNum, nextVNum), true);
+  for (unsigned int i = 0; i < commonVNum; i++) {
+    const float* a = current.vertices + 3 * (size_t)i;
+    const float* b = next.vertices + 3 * (size_t)i;
+    moved[i] = a[0] != b[0] || a[1] != b[1] || a[2] != b[2];
+    // The balls also collide with the vertices on their own
+    if (moved[i]) {
+      extend(current.getVertex(i));
+      extend(next.getVertex(i));
+    }
+  }
+
+  // The exact index changes decide which triangles changed, the merged ones
+  // are uploaded
+  std::vector<MeshRange> exactIndices;
+  diffArrays(current.indices, current.iCount, next.indices, next.iCount, 0,
+             exactIndices);
+  unsigned int commonIndices = std::min(current.iCount, next.iCount);
+  addTriangles(current, moved, exactIndices, commonIndices);
+  addTriangles(next, moved, exactIndices, commonIndices);
+
+  diffArrays(current.vertices, current.vCount, next.vertices, next.vCount,
+             mergeGap, vertexRanges);
+  diffArrays(current.indices, current.iCount, next.indices, next.iCount,
+             mergeGap, indexRanges);
+  changed = vertexResized || indexResized || !vertexRanges.empty() ||
+            !indexRanges.empty();
+}
+
+/**
+ * Turns the current mesh into the next version. If the sizes are the same,
+ * only the changed ranges are copied and the arrays are kept, otherwise the
+ * arrays are exchanged, and the next mesh gets the old ones.
+ */
+void MeshPatch::apply(Mesh& current, Mesh& next) const {
+  if (vertexResized || indexResized) {
+    current.swap(next);
+    return;
+  }
+  for (const MeshRange& r : vertexRanges)
+    std::copy(next.vertices + r.first, next.vertices + r.first + r.count,
+              current.vertices + r.first);
+  for (const MeshRange& r : indexRanges)
+    std::copy(next.indices + r.first, next.indices + r.first + r.count,
+              current.indices + r.first);
+  if (changed) current.touch();
+}
+
+/**
+ * Returns the box of the triangles that changed, in both versions of the
+ * mesh. Returns false if no triangle changed.
+ */
+bool MeshPatch::getBounds(Vec3* min_, Vec3* max_) const {
+  if (!bounded) return false;
+  *min_ = min;
+  *max_ = max;
+  return true;
+}
+
+/**
+ * Returns the size of the changed ranges of the arrays.
+ */
+size_t MeshPatch::getChangedBytes() const {
+  size_t bytes = 0;
+  for (const MeshRange& r : vertexRanges) bytes += sizeof(float) * r.count;
+  for (const MeshRange& r : indexRanges)
+    bytes += sizeof(unsigned int) * r.count;
+  return bytes;
+}
@@ -0,0 +1,165 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "MetricsLog.h"
+
+/**
+ * Initialises a closed log, nothing is recorded until a file is opened.
+ */
+MetricsLog::MetricsLog() {
+#ifndef __EMSCRIPTEN__
+  batchReady = stopping = false;
+#endif
+}
+
+/**
+ * Writes the remaining records and the summary.
+ */
+MetricsLog::~MetricsLog() { close(); }
+
+/**
+ * Opens the output file and starts the writer thread. Returns false if the
+ * file could not be opened.
+ */
+bool MetricsLog::open(const char* fileName) {
+  close();
+  file.open(fileName);
+  if (!file.is_open()) return false;
+  frameTimes.reset();
+  stepTimes.reset();
+  swapTimes.reset();
+  inputLatencies.reset();
+  for (int i = 0; i < STEP_PHASE_COUNT; i++) phaseTimes[i].reset();
+  pending.reserve(batchSize);
+#ifndef __EMSCRIPTEN__
+  writing.reserve(batchSize);
+  batchReady = stopping = false;
+  writer = std::thread(&MetricsLog::writerLoop, this);
+#endif
+  return true;
+}
+
+/**
+ * Adds the measurements of a frame. The histograms are updated right away,
+ * the record itself is only written once a whole batch is collected.
+ */
+void MetricsLog::record(const FrameMetrics& m) {
+  if (!file.is_open()) return;
+  frameTimes.record(m.frameNs);
+  swapTimes.record(m.swapNs);
+  if (m.inputLatencyNs > 0) inputLatencies.record(m.inputLatencyNs);
+  if (m.stepNs > 0) {
+    stepTimes.record(m.stepNs);
+    for (int i = 0; i < STEP_PHASE_COUNT; i++)
+      phaseTimes[i].record(m.step.phaseNs[i]);
+  }
+  pending.push_back(m);
+  if ((int)pending.size() >= batchSize) flushPending();
+}
+
+/**
+ * Hands the pending records over to the writer. If the writer is still busy
+ * with the previous batch, the frames keep collecting instead of waiting.
+ */
+void MetricsLog::flushPending() {
+#ifdef __EMSCRIPTEN__
+  writeBatch(pending);
+  pending.clear();
+#else
+  std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+  if (!lock.owns_lock() || batchReady) return;
+  writing.swap(pending);
+  pending.clear();
+  batchReady = true;
+  lock.unlock();
+  wakeUp.notify_one();
+#endif
+}
+
+#ifndef __EMSCRIPTEN__
+/**
+ * The body of the writer thread: waits for batches and writes them until the
+ * log is closed.
+ */
+void MetricsLog::writerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wakeUp.wait(lock, [this] { return batchReady || stopping; });
+    if (batchReady) {
+      // The batch is only touched by this thread until batchReady is cleared
+      lock.unlock();
+      writeBatch(writing);
+      lock.lock();
+      batchReady = false;
+    } else {
+      return;
+    }
+  }
+}
+#endif
+
+/**
+ * Writes a JSON line for each record of the batch.
+ */
+void MetricsLog::writeBatch(const std::vector<FrameMetrics>& batch) {
+  for (const FrameMetrics& m : batch) {
+    file << "{\"frame\":" << m.frame << ",\"frame_ms\":" << m.frameNs / 1e6
+         << ",\"step_ms\":" << m.stepNs / 1e6
+         << ",\"render_ms\":" << m.renderNs / 1e6
+         << ",\"swap_ms\":" << m.swapNs / 1e6
+         << ",\"input_latency_ms\":" << m.inputLatencyNs / 1e6
+         << ",\"input_wait_ms\":" << m.inputWaitNs / 1e6
+         << ",\"phases_ms\":{";
+    for (int i = 0; i < STEP_PHASE_COUNT; i++) {
+      file << (i > 0 ? "," : "") << '"' << stepPhaseNames[i]
+           << "\":" << (m.stepNs > 0 ? m.step.phaseNs[i] / 1e6 : 0);
+    }
+    file << "},\"balls\":" << m.balls << ",\"awake\":" << m.step.awakeBalls
+         << ",\"pair_tests\":" << m.step.ballBallTests
+         << ",\"triangle_tests\":" << m.step.ballWorldTests
+         << ",\"cache_rebuilds\":" << m.step.cacheRebuilds
+         << ",\"rebuild_scans\":" << m.step.rebuildScans
+         << ",\"contacts\":" << m.step.contacts
+         << ",\"resolved\":" << m.step.resolved << "}\n";
+  }
+}
+
+/**
+ * Writes the remaining records, stops the writer and appends the summary line
+ * with the histograms of the run (in milliseconds).
+ */
+void MetricsLog::close() {
+  if (!file.is_open()) return;
+#ifndef __EMSCRIPTEN__
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeUp.notify_one();
+  // The writer finishes the batch it was given before stopping
+  writer.join();
+#endif
+  writeBatch(pending);
+  pending.clear();
+
+  file << "{\"summary\":{\"frames\":" << frameTimes.getCount()
+       << ",\"frame_ms\":";
+  frameTimes.writeSummary(file);
+  file << ",\"step_ms\":";
+  stepTimes.writeSummary(file);
+  file << ",\"swap_ms\":";
+  swapTimes.writeSummary(file);
+  file << ",\"input_latency_ms\":";
+  inputLatencies.writeSummary(file);
+  for (int i = 0; i < STEP_PHASE_COUNT; i++) {
+    file << ",\"" << stepPhaseNames[i] << "_ms\":";
+    phaseTimes[i].writeSummary(file);
+  }
+  file << "}}\n";
+  file.close();
+}
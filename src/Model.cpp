@@ -8,31 +8,29 @@
 
 #include "Model.h"
 
+#include <algorithm>
+#include <utility>
+
+unsigned long Model::drawCalls = 0;
+
 /**
  * Initalises an empty model.
  */
-Model::Model() {
-  // Initalise vertex and index array pointers as NULL
-  vertices = NULL;
-  vCount = 0;
-  indices = NULL;
-  iCount = 0;
-
+Model::Model() : Mesh() {
   // Create vertex and index buffers for OpenGL
   glGenBuffers(1, &vertexBufferObj);
   glGenBuffers(1, &elementBufferObj);
+  gpuBytes = 0;
 }
 
 /**
  * Frees the loaded memory.
  */
 Model::~Model() {
-  // Remove model data from CPU memory
-  delete[] vertices;
-  delete[] indices;
-  // And remove the same data from GPU memory
+  // The CPU side data is freed by the mesh, only remove the GPU side data
   glDeleteBuffers(1, &vertexBufferObj);
   glDeleteBuffers(1, &elementBufferObj);
+  MemoryStats::add(GPU_BUFFER_MEMORY, -gpuBytes);
 }
 
 /**
@@ -67,6 +65,95 @@ void Model::loadToGL() const {
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObj);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * iCount, indices,
                GL_STATIC_DRAW);
+  int64_t bytes = sizeof(GLfloat) * vCount + sizeof(GLuint) * iCount;
+  MemoryStats::add(GPU_BUFFER_MEMORY, bytes - gpuBytes);
+  gpuBytes = bytes;
+}
+
+/**
+ * Returns the size of the vertex and index data uploaded to OpenGL.
+ */
+size_t Model::getGLBytes() const {
+  return sizeof(GLfloat) * vCount + sizeof(GLuint) * iCount;
+}
+
+/**
+ * Uploads a piece of at most the given size of the vertex data followed by
+ * the index data, starting from the given byte offset, so a large model can
+ * be uploaded over several frames. The buffers are allocated when the offset
+ * is 0. Returns the offset of the next piece, which is getGLBytes() when the
+ * upload is complete.
+ */
+size_t Model::uploadToGL(size_t offset, size_t maxBytes) const {
+  size_t vBytes = sizeof(GLfloat) * vCount;
+  size_t end = std::min(offset + maxBytes, getGLBytes());
+  if (offset == 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObj);
+    glBufferData(GL_ARRAY_BUFFER, vBytes, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObj);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, getGLBytes() - vBytes, NULL,
+                 GL_STATIC_DRAW);
+    MemoryStats::add(GPU_BUFFER_MEMORY, getGLBytes() - gpuBytes);
+    gpuBytes = getGLBytes();
+  }
+  if (offset < vBytes && offset < end) {
+    size_t n = std::min(end, vBytes) - offset;
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObj);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, n, (char*)vertices + offset);
+    offset += n;
+  }
+  if (offset < end) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObj);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset - vBytes, end - offset,
+                    (char*)indices + (offset - vBytes));
+  }
+  return end;
+}
+
+/**
+ * Updates the OpenGL buffers after the patch was applied to the model. A
+ * buffer whose size changed is uploaded again, otherwise only the changed
+ * ranges are replaced. Returns the number of bytes uploaded.
+ */
+size_t Model::uploadPatch(const MeshPatch& patch) const {
+  size_t uploaded = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObj);
+  if (patch.isVertexResized()) {
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vCount, vertices,
+                 GL_STATIC_DRAW);
+    uploaded += sizeof(GLfloat) * vCount;
+  } else {
+    for (const MeshRange& r : patch.getVertexRanges()) {
+      glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * r.first,
+                      sizeof(GLfloat) * r.count, vertices + r.first);
+      uploaded += sizeof(GLfloat) * r.count;
+    }
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObj);
+  if (patch.isIndexResized()) {
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * iCount, indices,
+                 GL_STATIC_DRAW);
+    uploaded += sizeof(GLuint) * iCount;
+  } else {
+    for (const MeshRange& r : patch.getIndexRanges()) {
+      glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * r.first,
+                      sizeof(GLuint) * r.count, indices + r.first);
+      uploaded += sizeof(GLuint) * r.count;
+    }
+  }
+  MemoryStats::add(GPU_BUFFER_MEMORY, getGLBytes() - gpuBytes);
+  gpuBytes = getGLBytes();
+  return uploaded;
+}
+
+/**
+ * Exchanges the geometry and the OpenGL buffers of the two models.
+ */
+void Model::swap(Model& other) {
+  Mesh::swap(other);
+  std::swap(vertexBufferObj, other.vertexBufferObj);
+  std::swap(elementBufferObj, other.elementBufferObj);
+  std::swap(gpuBytes, other.gpuBytes);
 }
 
 /**
@@ -87,6 +174,7 @@ void Model::render(GLint posAttrib, GLenum mode) const {
   glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
   // Render the model in the given mode
   glDrawElements(mode, iCount, GL_UNSIGNED_INT, 0);
+  drawCalls++;
 }
 
 /**
@@ -99,41 +187,5 @@ void Model::renderOneByOne(GLint posAttrib, GLenum mode) const {
   // Runs through the triangles in a for loop rendering them one by one
   for (GLuint i = 0; i < (iCount / 3); i++)
     glDrawElements(mode, 3, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * i * 3));
-}
-
-/**
- * Returns the number of vertices in the model.
- */
-GLuint Model::getVertexNum() const { return vCount / 3; }
-
-/**
- * Returns the vertex at the given index as a Vec3.
- */
-Vec3 Model::getVertex(GLuint index) const {
-  return Vec3(vertices[index * 3], vertices[index * 3 + 1],
-              vertices[index * 3 + 2]);
-}
-
-/**
- * Returns the number of triangles in the model.
- */
-GLuint Model::getTriangleNum() const { return iCount / 3; }
-
-/**
- * Loads the requested triangle's vertices into the Vec3 pointers.
- */
-void Model::getTriangle(GLuint index, Vec3* a, Vec3* b, Vec3* c) const {
-  (*a) = getVertex(indices[index * 3]);
-  (*b) = getVertex(indices[index * 3 + 1]);
-  (*c) = getVertex(indices[index * 3 + 2]);
-}
-
-/**
- * Loads the requested triangle's vertex indices into the pointers.
- */
-void Model::getTriangleIdx(GLuint index, GLuint* a, GLuint* b,
-                           GLuint* c) const {
-  (*a) = (indices[index * 3]);
-  (*b) = (indices[index * 3 + 1]);
-  (*c) = (indices[index * 3 + 2]);
+  drawCalls += iCount / 3;
 }
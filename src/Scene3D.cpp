@@ -8,6 +8,8 @@
 
 #include "Scene3D.h"
 
+#include <algorithm>
+
 #ifdef __EMSCRIPTEN__
 /**
  * Functions for retrieving the dimensions of the browser window when running in
@@ -31,7 +33,10 @@ void Scene3D::getBrowserDimensions(int* width, int* height) {
  * Initalises the application.
  * Cerates the window, loads the base scene and the shaders used for rendering.
  */
-Scene3D::Scene3D(char const* titleStr) : content((initWindow(titleStr), 18)) {
+Scene3D::Scene3D(char const* titleStr)
+    : content((initWindow(titleStr), 18)),
+      sim(&world),
+      rewindRing(rewindSnapshots) {
   // The variables indicating some button states
   WASDKeys[0] = WASDKeys[1] = WASDKeys[2] = WASDKeys[3] = spaceKey = shiftKey =
       timeStopped = false;
@@ -45,8 +50,25 @@ Scene3D::Scene3D(char const* titleStr) : content((initWindow(titleStr), 18)) {
   cam.setAspectRatio((float)width / height);
 
   // Initially there are zero balls in the system
-  balls = NULL;
-  ballCount = 0;
+  emitterActive = false;
+  lastFrameNs = lastStepNs = lastRenderNs = 0;
+  oldestInputNs = lastInputLatencyNs = lastInputWaitNs = lastSwapNs = 0;
+  finishBeforeTiming = false;
+  recordingInput = replayingInput = false;
+  inputFrame = 0;
+  uploadingWorld = false;
+  uploadedBytes = 0;
+#ifdef __EMSCRIPTEN__
+  // The browser build has no threads to load on
+  slicedLoading = true;
+#else
+  slicedLoading = false;
+#endif
+  autosaveNs = lastAutosaveNs = 0;
+  watchingScene = reloadingScene = false;
+  lastWatchNs = 0;
+  loader.setCache(&sceneCache);
+  framesSinceSnapshot = 0;
 
   loadGeometry();
   initShaders();
@@ -59,6 +81,7 @@ Scene3D::Scene3D(char const* titleStr) : content((initWindow(titleStr), 18)) {
 Scene3D::~Scene3D() {
   // Delete balls from memory
   clearBalls();
+  closeStreamed();
   // Remove shaders from memory
   glDeleteShader(vertexShader);
   glDeleteShader(pixelShader);
@@ -111,19 +134,11 @@ void Scene3D::loadGeometry() {
   content.loadModel();
   content.loadToGL();
 
-  std::ifstream file;
-  file.exceptions(std::ifstream::badbit);
-  try {
-    // Load the file with the overloaded operator
-    file.open("base.scene");
-    file >> (*this);
-  } catch (const std::ifstream::failure& e) {
-    SDL_Log("Could not open and read file: base.scene");
-  }
-  file.close();
-
-  // Load the scene geometry into GPU memory
-  world.loadToGL();
+  // Prefer the compressed base scene, which is smaller to download
+  if (CompressedScene::isCompressed("base.cscene"))
+    loadScene("base.cscene");
+  else
+    loadScene("base.scene");
 }
 
 /**
@@ -205,13 +220,56 @@ void Scene3D::enterLoop() {
   // The main loop behaviour is inside a lambda function
   // Probably not the best method but the easiest right now
   auto loopFunc = [this] {
+    FrameRecorder::beginFrame();
+    uint64_t frameStart = FrameRecorder::now();
+
     // Run the event handler
-    handleEvents();
+    oldestInputNs = 0;
+    {
+      TRACE_ZONE("handleEvents");
+      handleEvents();
+    }
 
     // Call the main loop behavoiur function
     mainLoop(SDL_GetTicks());
 
-    SDL_GL_SwapWindow(window);
+    // The frame is presented when the swap returns, or when the GPU finished
+    // it if glFinish is enabled (F7)
+    uint64_t swapStart = FrameRecorder::now();
+    {
+      TRACE_ZONE("SDL_GL_SwapWindow");
+      SDL_GL_SwapWindow(window);
+      if (finishBeforeTiming) glFinish();
+    }
+    uint64_t presented = FrameRecorder::now();
+    lastSwapNs = presented - swapStart;
+
+    // The latency of the oldest input of the frame consists of the time it
+    // waited for the frame, the physics step, the rendering and the swap
+    lastInputLatencyNs = lastInputWaitNs = 0;
+    if (oldestInputNs > 0) {
+      lastInputLatencyNs = presented - oldestInputNs;
+      lastInputWaitNs = frameStart > oldestInputNs ? frameStart - oldestInputNs
+                                                   : 0;
+      inputLatencies.record(lastInputLatencyNs);
+    }
+
+    // Slow frames are dumped automatically by the recorder
+    lastFrameNs = FrameRecorder::endFrame();
+    hud.addSample(lastFrameNs / 1e6f, lastStepNs / 1e6f);
+    if (metrics.isOpen()) {
+      FrameMetrics m;
+      m.frame = FrameRecorder::getFrame();
+      m.frameNs = lastFrameNs;
+      m.stepNs = lastStepNs;
+      m.renderNs = lastRenderNs;
+      m.swapNs = lastSwapNs;
+      m.inputLatencyNs = lastInputLatencyNs;
+      m.inputWaitNs = lastInputWaitNs;
+      m.balls = sim.getBalls().size();
+      m.step = sim.getStats();
+      metrics.record(m);
+    }
   };
 
 #ifdef __EMSCRIPTEN__
@@ -228,29 +286,72 @@ void Scene3D::enterLoop() {
 }
 
 void Scene3D::mainLoop(Uint32 t) {
+  TRACE_ZONE("mainLoop");
   // Set background color (black)
   glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  Model::resetDrawCalls();
+
+  // Activate the scene loaded in the background when it is ready
+  updateLoading();
+  updateWatching();
+  updateSaving();
+
+  // When replaying, the recorded input of this frame replaces the user's
+  float dt = 1.0f / 60.0f;
+  if (replayingInput) {
+    dt = inputRecording.getDt();
+    const InputEvent* e;
+    while ((e = inputRecording.next(inputFrame)) != NULL) applyInput(*e);
+  } else {
+    // Move camera when WASD or space or shift is pressed
+    if (WASDKeys[1]) cam.moveBy(-cam.getRightDir() * 1.8f);
+    if (WASDKeys[3]) cam.moveBy(cam.getRightDir() * 1.8f);
+    if (WASDKeys[0]) cam.moveBy(cam.getForwardDir() * 1.8f);
+    if (WASDKeys[2]) cam.moveBy(-cam.getForwardDir() * 1.8f);
+    if (spaceKey) cam.moveBy(Vec3(0.0f, 1.8f, 0.0f));
+    if (shiftKey) cam.moveBy(Vec3(0.0f, -1.8f, 0.0f));
+
+    // Only the camera movements are recorded, not the keys themselves
+    if (recordingInput && ((cam.getPos() - lastCamPos).lenSq() > 0 ||
+                           (cam.getDir() - lastCamDir).lenSq() > 0)) {
+      InputEvent e(CAMERA_INPUT);
+      e.pos = lastCamPos = cam.getPos();
+      e.vel = lastCamDir = cam.getDir();
+      userInput(e);
+    }
+
+    // The stream of the active emitter follows the camera
+    if (emitterActive && emitter.getPattern() == STREAM_EMITTER) {
+      InputEvent e(EMITTER_STREAM_INPUT);
+      e.pos = cam.getPos();
+      e.vel = cam.getDir() * 150.0f;
+      userInput(e);
+    }
+  }
 
-  // Move camera when WASD or space or shift is pressed
-  if (WASDKeys[1]) cam.moveBy(-cam.getRightDir() * 1.8f);
-  if (WASDKeys[3]) cam.moveBy(cam.getRightDir() * 1.8f);
-  if (WASDKeys[0]) cam.moveBy(cam.getForwardDir() * 1.8f);
-  if (WASDKeys[2]) cam.moveBy(-cam.getForwardDir() * 1.8f);
-  if (spaceKey) cam.moveBy(Vec3(0.0f, 1.8f, 0.0f));
-  if (shiftKey) cam.moveBy(Vec3(0.0f, -1.8f, 0.0f));
+  // Load the tiles of a streamed scene around the camera and the balls
+  updateStreaming();
 
   // Update the balls if time is not frozen
+  lastStepNs = 0;
   if (!timeStopped) {
-    Vec3 gravity = Vec3(0, -200, 0);
-    for (int i = 0; i < ballCount; i++) {
-      balls[i].update(1.0f / 60.0f, gravity);
-      // Ball-ball collisions
-      for (int j = i + 1; j < ballCount; j++) Ball::collide(balls[i], balls[j]);
-      // Ball-world collisions
-      balls[i].collideWithModel(world);
+    // Spawn the balls of the active emitter
+    if (emitterActive) {
+      emitter.update(dt, sim.getBalls());
+      if (emitter.isFinished()) emitterActive = false;
+    }
+    uint64_t stepStart = FrameRecorder::now();
+    sim.step(dt);
+    lastStepNs = FrameRecorder::now() - stepStart;
+    // Keep the recent states for rewinding
+    if (++framesSinceSnapshot >= snapshotInterval) {
+      TRACE_ZONE("state snapshot");
+      rewindRing.push(sim);
+      framesSinceSnapshot = 0;
     }
   }
+  uint64_t renderStart = FrameRecorder::now();
 
   // Set matrices
   Matrix modelViewMatrix;
@@ -260,25 +361,86 @@ void Scene3D::mainLoop(Uint32 t) {
                      modelViewMatrix.getElements());
 
   // Render the world
-  // Normal rendering
-  glUniform4f(colorLocation, 0.75f, 0.75f, 0.75f, 1.0f);
-  world.render(posAttrib);
+  if (heatmapOverlay.isVisible()) {
+    // Colored by the collision costs, refreshed twice a second
+    TRACE_ZONE("heatmap.render");
+    if (FrameRecorder::getFrame() % 30 == 0)
+      heatmapOverlay.update(world, sim.getHeatmap());
+    heatmapOverlay.render(world, posAttrib, colorLocation);
+  } else if (streamer.isOpen()) {
+    // Every resident tile has its own buffers
+    TRACE_ZONE("tiles.render");
+    glUniform4f(colorLocation, 0.75f, 0.75f, 0.75f, 1.0f);
+    for (const Model* tile : tileModels)
+      if (tile != NULL) tile->render(posAttrib);
+  } else {
+    // Normal rendering
+    TRACE_ZONE("world.render");
+    glUniform4f(colorLocation, 0.75f, 0.75f, 0.75f, 1.0f);
+    world.render(posAttrib);
+  }
   // Wireframe rendering
   glUniform4f(colorLocation, 0.05f, 0.05f, 0.2f, 1.0f);
-  world.renderOneByOne(posAttrib, GL_LINE_LOOP);
+  {
+    TRACE_ZONE("renderOneByOne");
+    if (streamer.isOpen()) {
+      for (const Model* tile : tileModels)
+        if (tile != NULL) tile->renderOneByOne(posAttrib, GL_LINE_LOOP);
+    } else {
+      world.renderOneByOne(posAttrib, GL_LINE_LOOP);
+    }
+  }
 
   // Render the balls
-  for (int i = 0; i < ballCount; i++) {
-    // Set the transform of the ball
-    modelViewMatrix = balls[i].getModelViewMatrix();
-    glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE,
-                       modelViewMatrix.getElements());
+  const BallStore& balls = sim.getBalls();
+  {
+    TRACE_ZONE("render balls");
+    for (int i = 0; i < balls.size(); i++) {
+      // Set the transform of the ball
+      modelViewMatrix = balls[i].getModelViewMatrix();
+      glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE,
+                         modelViewMatrix.getElements());
+
+      // Render the sphere looking like a beach ball
+      glUniform4f(colorLocation, 0.75f, 0.12f, 0.12f, 1.0f);
+      content.renderStriped(posAttrib);
+      glUniform4f(colorLocation, 0.8f, 0.8f, 0.8f, 1.0f);
+      content.renderStriped(posAttrib, true);
+    }
+  }
+  lastRenderNs = FrameRecorder::now() - renderStart;
+
+  // Render the performance overlay on top
+  if (hud.isVisible()) {
+    TRACE_ZONE("hud.render");
+    const StepStats& stats = sim.getStats();
+    HudStats hudStats;
+    hudStats.frameMs = lastFrameNs / 1e6f;
+    hudStats.stepMs = lastStepNs / 1e6f;
+    hudStats.balls = balls.size();
+    hudStats.awakeBalls = stats.awakeBalls;
+    hudStats.pairTests = stats.ballBallTests;
+    hudStats.triangleTests = stats.ballWorldTests;
+    hudStats.cacheRebuilds = stats.cacheRebuilds;
+    hudStats.contacts = stats.contacts;
+    hudStats.resolved = stats.resolved;
+    hudStats.drawCalls = Model::getDrawCalls();
+    hudStats.swapMs = lastSwapNs / 1e6f;
+    hudStats.memoryMb = MemoryStats::getTotal() / 1048576.0f;
+    hudStats.memoryPeakMb = MemoryStats::getTotalPeak() / 1048576.0f;
+    hudStats.inputMs = lastInputLatencyNs / 1e6f;
+    hudStats.inputP50Ms = inputLatencies.getPercentile(50) / 1e6f;
+    hudStats.inputP99Ms = inputLatencies.getPercentile(99) / 1e6f;
+    hudStats.loadPercent = getLoadPercent();
+    hud.render(posAttrib, colorLocation, projectionLocation,
+               modelViewLocation, width, height, hudStats);
+  }
 
-    // Render the sphere looking like a beach ball
-    glUniform4f(colorLocation, 0.75f, 0.12f, 0.12f, 1.0f);
-    content.renderStriped(posAttrib);
-    glUniform4f(colorLocation, 0.8f, 0.8f, 0.8f, 1.0f);
-    content.renderStriped(posAttrib, true);
+  // Count the frames of the recording or the replay
+  inputFrame++;
+  if (replayingInput && inputFrame >= inputRecording.getFrameCount()) {
+    replayingInput = false;
+    SDL_Log("Replay finished after %u frames", inputFrame);
   }
 }
 
@@ -308,7 +470,18 @@ void Scene3D::keyDownEvent(const SDL_KeyboardEvent& e) {
       break;
     case SDLK_r:
       // Clears the ball array when pressing R
-      clearBalls();
+      userInput(InputEvent(CLEAR_BALLS_INPUT));
+      break;
+    case SDLK_e:
+      // Toggle a stream of balls shot out of the camera when pressing E
+      if (emitterActive)
+        userInput(InputEvent(EMITTER_STOP_INPUT));
+      else
+        startEmitter(STREAM_EMITTER, 1000, 20.0f);
+      break;
+    case SDLK_g:
+      // Drop a grid of balls in front of the camera when pressing G
+      startEmitter(GRID_EMITTER, 500, 250.0f);
       break;
     default:
       break;
@@ -342,14 +515,80 @@ void Scene3D::keyUpEvent(const SDL_KeyboardEvent& e) {
     case SDLK_LSHIFT:
       shiftKey = false;
       break;
-    case SDLK_t:
+    case SDLK_t: {
       // Stop the time when pressing T
-      timeStopped = !timeStopped;
+      InputEvent stop(TIME_STOP_INPUT);
+      stop.flag = !timeStopped;
+      userInput(stop);
       break;
+    }
     case SDLK_p:
       // Save the scene into a file when pressing P
       saveScene("saved.scene");
       break;
+    case SDLK_c:
+      // Show the collision heatmap when pressing C, counting starts over
+      heatmapOverlay.toggle();
+      sim.setHeatmapEnabled(heatmapOverlay.isVisible());
+      if (heatmapOverlay.isVisible()) {
+        sim.resetHeatmap();
+        // The overlay draws from the buffers of the world, which are not
+        // kept up to date while streaming
+        if (streamer.isOpen()) world.loadToGL();
+        heatmapOverlay.update(world, sim.getHeatmap());
+      }
+      break;
+    case SDLK_F5:
+      // Start or stop recording the input when pressing F5
+      if (recordingInput)
+        stopRecording("input.rec");
+      else
+        startRecording();
+      break;
+    case SDLK_F6:
+      // Replay the recorded input when pressing F6, or stop the replay
+      if (replayingInput)
+        replayingInput = false;
+      else
+        startReplay("input.rec");
+      break;
+    case SDLK_F7:
+      // Toggle waiting for the GPU before timing the presentation
+      finishBeforeTiming = !finishBeforeTiming;
+      SDL_Log("glFinish before presentation timing %s",
+              finishBeforeTiming ? "on" : "off");
+      break;
+    case SDLK_F8:
+      // Save the per-triangle collision costs when pressing F8
+      saveHeatmap("heatmap.csv");
+      break;
+    case SDLK_h:
+      // Show or hide the performance overlay when pressing H
+      hud.toggle();
+      break;
+    case SDLK_BACKSPACE:
+      // Go back to the previous snapshot when pressing Backspace
+      rewind();
+      break;
+    case SDLK_F10:
+      // Save the whole state of the simulation when pressing F10
+      saveState("state.snap");
+      break;
+    case SDLK_F11:
+      // Continue from the saved state when pressing F11
+      loadState("state.snap");
+      break;
+    case SDLK_F12:
+      // Reload the scene whenever its file changes when pressing F12
+      watchingScene = !watchingScene;
+      SDL_Log("Watching %s %s", scenePath.c_str(),
+              watchingScene ? "on" : "off");
+      break;
+    case SDLK_F9:
+      // Dump the last frames of the flight recorder when pressing F9
+      if (FrameRecorder::dump("trace.json"))
+        SDL_Log("Saved the last frames into trace.json");
+      break;
     default:
       break;
   }
@@ -359,6 +598,8 @@ void Scene3D::keyUpEvent(const SDL_KeyboardEvent& e) {
  * Handles mouse motion, rotates the camera accordingly.
  */
 void Scene3D::mouseMotionEvent(const SDL_MouseMotionEvent& e) {
+  // The replay controls the camera
+  if (replayingInput) return;
   cam.tiltUp(-(float)e.yrel / 1500.0f);
   cam.turnRight((float)e.xrel / 1500.0f);
 }
@@ -394,61 +635,446 @@ void Scene3D::resizeEvent(int width, int height) {
 }
 
 /**
- * Handles the file drag and drop event.
+ * Handles the file drag and drop event. The scene is loaded in the
+ * background, the current one keeps running until it is ready.
  */
 void Scene3D::fileDropEvent(const char* fName) {
+  if (!replayingInput) startLoading(fName);
+}
+
+/**
+ * Loads the scene in the given file and uploads its geometry to the GPU. Baked
+ * scenes are memory mapped, text scenes are parsed.
+ */
+void Scene3D::loadScene(const char* fName) {
   SDL_Log("Loading file %s", fName);
-  std::ifstream file;
-  file.exceptions(std::ifstream::badbit);
-  try {
-    // Load the file containing a scene with the overloaded operator
-    file.open(fName);
-    file >> (*this);
-  } catch (const std::ifstream::failure& e) {
+  emitterActive = false;
+  if (BakedScene::isBaked(fName) && openStreamed(fName)) return;
+  uint64_t start = FrameRecorder::now();
+  if (!sim.load(fName, &sceneCache))
     SDL_Log("Could not open and read file: %s", fName);
+  SDL_Log("Loaded in %.2f ms", (FrameRecorder::now() - start) / 1e6);
+  sceneSourceChanged(fName);
+  sceneLoaded();
+}
+
+/**
+ * Uploads the geometry of a newly loaded scene to the GPU and reports the
+ * memory it needs.
+ */
+void Scene3D::sceneLoaded() {
+  closeStreamed();
+  // A good thing is that OpenGL deletes the old geometry data if this is not
+  // the first scene loaded
+  world.loadToGL();
+  // The snapshots of the old scene can not be restored on the new world
+  rewindRing.clear();
+  framesSinceSnapshot = 0;
+  reportMemory();
+}
+
+/**
+ * Starts loading the scene in the given file into the second world on a
+ * background thread, or in time slices of the following frames. It is
+ * activated by updateLoading when it is ready.
+ */
+void Scene3D::startLoading(const char* fName) {
+  if (loader.isLoading() || uploadingWorld) {
+    SDL_Log("Still loading %s, ignoring %s", loader.getFileName().c_str(),
+            fName);
+    return;
+  }
+  // Opening a streamed scene only reads its tile table, its tiles are loaded
+  // in the following frames
+  if (BakedScene::isBaked(fName) && openStreamed(fName)) {
+    InputEvent e(LOAD_SCENE_INPUT);
+    e.path = fName;
+    recordInput(e);
+    return;
+  }
+  SDL_Log("Loading file %s %s", fName,
+          slicedLoading ? "in time slices" : "in the background");
+  loader.start(fName, loadingWorld, slicedLoading);
+}
+
+/**
+ * Advances the scene loaded in the background, parsing the next part of it
+ * if it is loaded in time slices. Once it is parsed, its
+ * geometry is uploaded to the GPU in pieces over the following frames, then
+ * the new world and its balls replace the current scene at once.
+ */
+void Scene3D::updateLoading() {
+  if (loader.isLoading()) {
+    TRACE_ZONE("scene load slice");
+    loader.resume(loadBudgetNs);
+  }
+  if (loader.poll()) {
+    const char* fName = loader.getFileName().c_str();
+    bool reload = reloadingScene;
+    reloadingScene = false;
+    if (!loader.hasSucceeded())
+      SDL_Log("Could not open and read file: %s", fName);
+    else if (replayingInput)
+      SDL_Log("Discarding %s, a replay has started", fName);
+    else if (reload)
+      applyReload();
+    else {
+      if (loader.wasCached())
+        SDL_Log("Took %s from the scene cache in %.2f ms", fName,
+                loader.getLoadNs() / 1e6);
+      else
+        SDL_Log("Parsed %s in %.2f ms (%d frames)", fName,
+                loader.getLoadNs() / 1e6, std::max(loader.getSlices(), 1));
+      uploadingWorld = true;
+      uploadedBytes = 0;
+    }
   }
-  file.close();
+  if (!uploadingWorld) return;
+
+  TRACE_ZONE("world upload");
+  uploadedBytes = loadingWorld.uploadToGL(uploadedBytes, uploadBytesPerFrame);
+  if (uploadedBytes < loadingWorld.getGLBytes()) return;
+  uploadingWorld = false;
+  closeStreamed();
+  world.swap(loadingWorld);
+  sim.setScene(loader.getBalls(), loader.getKillVolumes());
+  sceneSourceChanged(loader.getFileName());
+  emitterActive = false;
+  rewindRing.clear();
+  framesSinceSnapshot = 0;
+  if (heatmapOverlay.isVisible())
+    heatmapOverlay.update(world, sim.getHeatmap());
+  // Free the old world, including its GPU buffers
+  loadingWorld.releaseArrays();
+  loadingWorld.loadToGL();
 
-  // Load the newly read geometry to GPU memory
+  // Replays load the scene at the frame it was activated
+  InputEvent e(LOAD_SCENE_INPUT);
+  e.path = loader.getFileName();
+  recordInput(e);
+  reportMemory();
+}
+
+/**
+ * Remembers the file the current world was loaded from, and its version, so
+ * the watch only reloads it after it changes.
+ */
+void Scene3D::sceneSourceChanged(const std::string& fileName) {
+  scenePath = fileName;
+  if (!SceneCache::makeKey(fileName.c_str(), watchedKey)) watchedKey = {};
+  lastWatchNs = FrameRecorder::now();
+}
+
+/**
+ * Checks the file of the current scene a few times a second if watching is
+ * enabled, and starts loading it again when it changes. Recordings and
+ * replays need the scene to stay the same, so it is not watched during them.
+ */
+void Scene3D::updateWatching() {
+  if (!watchingScene || scenePath.empty() || recordingInput ||
+      replayingInput || loader.isLoading() || uploadingWorld ||
+      streamer.isOpen())
+    return;
+  uint64_t now = FrameRecorder::now();
+  if (now - lastWatchNs < watchIntervalNs) return;
+  lastWatchNs = now;
+  SceneKey key;
+  // The file may be missing for a moment while an editor replaces it
+  if (!SceneCache::makeKey(scenePath.c_str(), key) || key == watchedKey)
+    return;
+  watchedKey = key;
+  SDL_Log("Reloading %s", scenePath.c_str());
+  reloadingScene = true;
+  loader.start(scenePath.c_str(), loadingWorld, slicedLoading);
+}
+
+/**
+ * Updates the current world to the reloaded version of its file. Only the
+ * changed parts of the geometry are uploaded to the GPU, and only the balls
+ * near them rebuild their geometry caches. The balls stay where they are,
+ * the kill volumes are replaced by the ones in the file.
+ */
+void Scene3D::applyReload() {
+  TRACE_ZONE("scene reload");
+  uint64_t start = FrameRecorder::now();
+  MeshPatch patch;
+  patch.compute(world, loadingWorld);
+  patch.apply(world, loadingWorld);
+  size_t uploaded = world.uploadPatch(patch);
+  sim.clearKillVolumes();
+  for (const KillVolume& v : loader.getKillVolumes()) sim.addKillVolume(v);
+  int rebuilt = sim.worldChanged(patch);
+  if (heatmapOverlay.isVisible() && !patch.isEmpty())
+    heatmapOverlay.update(world, sim.getHeatmap());
+  // Free the previous version, its GPU buffers were never used
+  loadingWorld.releaseArrays();
+  SDL_Log("Reloaded %s in %.2f ms: %d+%d ranges, %.1f KiB uploaded, "
+          "%d ball caches rebuilt",
+          scenePath.c_str(), (FrameRecorder::now() - start) / 1e6,
+          (int)patch.getVertexRanges().size(),
+          (int)patch.getIndexRanges().size(), uploaded / 1024.0, rebuilt);
+}
+
+/**
+ * Opens a scene baked with a tile size for streaming, replacing the current
+ * scene. Its tiles are loaded by updateStreaming around the camera and the
+ * balls. Returns false if the file is not a tiled scene.
+ */
+bool Scene3D::openStreamed(const char* fName) {
+  std::vector<Ball> newBalls;
+  std::vector<KillVolume> newKillVolumes;
+  if (!streamer.open(fName, newBalls, newKillVolumes)) return false;
+  for (Model* tile : tileModels) delete tile;
+  tileModels.assign(streamer.getTileNum(), NULL);
+  // The world only holds the resident tiles from now on, and it is not
+  // rendered itself
+  world.releaseArrays();
   world.loadToGL();
+  sim.setScene(newBalls, newKillVolumes);
+  Vec3 min, max;
+  streamer.getBounds(&min, &max);
+  sim.setWorldBounds(min, max);
+  emitterActive = false;
+  rewindRing.clear();
+  framesSinceSnapshot = 0;
+  sceneSourceChanged(fName);
+  SDL_Log("Streaming %s: %d tiles, keeping %.1f MB", fName,
+          streamer.getTileNum(), streamer.getBudget() / 1048576.0);
+  updateStreaming();
+  reportMemory();
+  return true;
+}
+
+/**
+ * Stops streaming the current scene, freeing the buffers of its tiles.
+ */
+void Scene3D::closeStreamed() {
+  if (!streamer.isOpen()) return;
+  streamer.close();
+  for (Model* tile : tileModels) delete tile;
+  tileModels.clear();
+}
+
+/**
+ * Loads the tiles of the streamed scene near the camera and the balls, and
+ * drops the tiles not needed for the longest time if they take too much
+ * memory. The loaded tiles are uploaded into their own buffers, and only the
+ * balls near them rebuild their geometry caches.
+ */
+void Scene3D::updateStreaming() {
+  if (!streamer.isOpen()) return;
+  Vec3 camPos = cam.getPos();
+  if (!streamer.update(world, &camPos, sim.getBalls())) return;
+  TRACE_ZONE("tile upload");
+  for (int t : streamer.getEvicted()) {
+    delete tileModels[t];
+    tileModels[t] = NULL;
+  }
+  for (int t : streamer.getLoaded()) {
+    delete tileModels[t];
+    tileModels[t] = new Model();
+    streamer.copyTile(world, t, *tileModels[t]);
+    tileModels[t]->loadToGL();
+  }
+  sim.tilesChanged(streamer);
+  if (heatmapOverlay.isVisible()) {
+    world.loadToGL();
+    heatmapOverlay.update(world, sim.getHeatmap());
+  }
+}
+
+/**
+ * Returns the progress of the scene being loaded in percent, or -1 if there
+ * is none. Parsing is counted as 90% of the load, the upload as the rest.
+ */
+float Scene3D::getLoadPercent() const {
+  if (loader.isLoading()) return 90 * loader.getProgress();
+  if (!uploadingWorld) return -1;
+  size_t total = loadingWorld.getGLBytes();
+  return 90 + (total > 0 ? 10.0f * uploadedBytes / total : 0);
+}
+
+/**
+ * Logs the memory held by each subsystem.
+ */
+void Scene3D::reportMemory() {
+  std::stringstream report;
+  MemoryStats::print(report);
+  std::string line;
+  SDL_Log("Memory after loading the scene:");
+  while (std::getline(report, line)) SDL_Log("  %s", line.c_str());
+}
+
+/**
+ * Returns a ball with the default settings used for shooting.
+ */
+Ball Scene3D::makeBall(const Vec3& pos, const Vec3& vel) const {
+  Ball b(pos, 5);
+  b.setVel(vel);
+  b.setBounciness(0.15f);
+  b.setFrictionCoefficient(0.3f);
+  return b;
 }
 
 /**
  * Shoots a ball out of the camera.
  */
 void Scene3D::placeBall() {
-  Ball* newAddr = new Ball[ballCount + 1];
-  std::memcpy(newAddr, balls, sizeof(Ball) * ballCount);
-  ballCount++;
-  if (balls != NULL) delete[] balls;
-  balls = newAddr;
-  // Set the default settings for the new ball
-  balls[ballCount - 1].setPosition(cam.getPos());
-  balls[ballCount - 1].setVel(cam.getDir());
-  balls[ballCount - 1].setRadius(5);
-  balls[ballCount - 1].setBounciness(0.15f);
-  balls[ballCount - 1].setFrictionCoefficient(0.3f);
+  InputEvent e(PLACE_BALL_INPUT);
+  e.setBall(makeBall(cam.getPos(), cam.getDir()));
+  userInput(e);
 }
 
 /**
- * Appends a ball to the current ones present.
+ * Appends a ball to the current ones present and gives it a new id.
  */
-void Scene3D::addBall(const Ball& b) {
-  Ball* newAddr = new Ball[ballCount + 1];
-  std::memcpy(newAddr, balls, sizeof(Ball) * ballCount);
-  ballCount++;
-  if (balls != NULL) delete[] balls;
-  balls = newAddr;
-  balls[ballCount - 1] = b;
-}
+void Scene3D::addBall(const Ball& b) { sim.addBall(b); }
 
 /**
- * Removes the balls from the scene and frees up allocated memory.
+ * Removes the balls from the scene.
  */
 void Scene3D::clearBalls() {
-  if (balls != NULL) delete[] balls;
-  balls = NULL;
-  ballCount = 0;
+  sim.clearBalls();
+  emitterActive = false;
+}
+
+/**
+ * Starts spawning count balls with the given rate in the given pattern. The
+ * grid and jittered patterns fill a box in front of the camera, the stream is
+ * shot out of the camera. Space for all the balls is reserved up front.
+ */
+void Scene3D::startEmitter(EmitterPattern pattern, int count,
+                           float ballsPerSecond) {
+  Vec3 center = cam.getPos() + cam.getForwardDir() * 100.0f;
+  InputEvent e(EMITTER_START_INPUT);
+  e.setBall(makeBall(center, Vec3(0, 0, 0)));
+  e.pattern = pattern;
+  e.count = count;
+  e.rate = ballsPerSecond;
+  e.boxMin = center - Vec3(50, 0, 50);
+  e.boxMax = center + Vec3(50, 50, 50);
+  e.seed = SDL_GetTicks();
+  userInput(e);
+}
+
+/**
+ * Applies an action of the user, unless a replay is running. The action is
+ * recorded if the input is being recorded.
+ */
+void Scene3D::userInput(const InputEvent& e) {
+  if (!replayingInput) applyInput(e);
+}
+
+/**
+ * Stores an action in the recording with the current frame if the input is
+ * being recorded.
+ */
+void Scene3D::recordInput(InputEvent e) {
+  if (!recordingInput) return;
+  e.frame = inputFrame;
+  inputRecording.add(e);
+}
+
+/**
+ * Carries out a recorded or a user action, storing it in the recording with
+ * the current frame if the input is being recorded.
+ */
+void Scene3D::applyInput(InputEvent e) {
+  recordInput(e);
+  switch (e.type) {
+    case CAMERA_INPUT:
+      // The user moves the camera directly, only replays have to set it
+      if (replayingInput) {
+        cam.setPos(e.pos);
+        cam.setDir(e.vel);
+      }
+      break;
+    case PLACE_BALL_INPUT:
+      addBall(e.makeBall());
+      break;
+    case CLEAR_BALLS_INPUT:
+      clearBalls();
+      break;
+    case TIME_STOP_INPUT:
+      timeStopped = e.flag;
+      break;
+    case EMITTER_START_INPUT:
+      emitter = e.makeEmitter();
+      emitter.start(sim.getBalls());
+      emitterActive = true;
+      break;
+    case EMITTER_STOP_INPUT:
+      emitterActive = false;
+      break;
+    case EMITTER_STREAM_INPUT:
+      emitter.setStream(e.pos, e.vel);
+      break;
+    case LOAD_SCENE_INPUT:
+      loadScene(e.path.c_str());
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Starts recording the input. The recording stores the exact state of the
+ * running simulation, so the replays start from the same state as the
+ * recording without the scene being reloaded.
+ */
+void Scene3D::startRecording() {
+  if (replayingInput) return;
+  // The recording stores the world, which is only partly loaded if streamed
+  if (streamer.isOpen()) {
+    SDL_Log("Streamed scenes can not be recorded");
+    return;
+  }
+  // The progress of the emitter is not part of the recorded state
+  emitterActive = false;
+  inputRecording.start(sim, 1.0f / 60.0f, timeStopped);
+  inputFrame = 0;
+  recordingInput = true;
+  // The replay starts from the current view
+  InputEvent e(CAMERA_INPUT);
+  e.pos = lastCamPos = cam.getPos();
+  e.vel = lastCamDir = cam.getDir();
+  applyInput(e);
+  SDL_Log("Recording the input");
+}
+
+/**
+ * Stops recording the input and saves the recording into the given file.
+ */
+void Scene3D::stopRecording(const char* fileName) {
+  recordingInput = false;
+  inputRecording.finish(inputFrame);
+  if (inputRecording.save(fileName))
+    SDL_Log("Saved %u frames of input into %s",
+            inputRecording.getFrameCount(), fileName);
+  else
+    SDL_Log("Could not write file: %s", fileName);
+}
+
+/**
+ * Replays the input recorded in the given file, starting from the state
+ * stored in it. Returns false if the file could not be read.
+ */
+bool Scene3D::startReplay(const char* fileName) {
+  if (recordingInput) stopRecording(fileName);
+  if (!inputRecording.load(fileName)) {
+    SDL_Log("Could not open and read file: %s", fileName);
+    return false;
+  }
+  emitterActive = false;
+  inputRecording.restore(sim);
+  sceneLoaded();
+  timeStopped = inputRecording.isStartStopped();
+  inputRecording.rewind();
+  inputFrame = 0;
+  replayingInput = true;
+  SDL_Log("Replaying %u frames of input from %s",
+          inputRecording.getFrameCount(), fileName);
+  return true;
 }
 
 /**
@@ -457,80 +1083,130 @@ void Scene3D::clearBalls() {
  * stores the position and size of balls.
  */
 std::ostream& operator<<(std::ostream& os, const Scene3D& scene) {
-  // Store balls
-  for (int i = 0; i < scene.ballCount; i++) {
-    Ball& b = scene.balls[i];
-    Vec3 pos = b.getPosition();
-    os << "#ball " << pos.x << ' ' << pos.y << ' ' << pos.z << ' '
-       << b.getRadius() << ' ' << b.getDensity() << ' '
-       << b.getAngularMassMultiplier() << ' ' << b.getBounciness() << ' '
-       << b.getFrictionCoefficient() << '\n';
-  }
-  // Indicate that there are no more balls to be read
-  os << "#end\n";
+  return os << scene.sim;
+}
+
+/**
+ * Loads a scene from a file.
+ */
+std::istream& operator>>(std::istream& is, Scene3D& scene) {
+  scene.emitterActive = false;
+  is >> scene.sim;
+  scene.sceneLoaded();
+  return is;
+}
 
-  // Store vertices
-  auto vNum = scene.world.getVertexNum();
-  for (int i = 0; i < vNum; i++) {
-    auto v = scene.world.getVertex(i);
-    os << "v " << v.x << ' ' << v.y << ' ' << v.z << '\n';
+/**
+ * Starts saving the scene with the given file name on a background thread.
+ * The result is logged by updateSaving when the file is written.
+ */
+void Scene3D::saveScene(const char* fileName) {
+  // The world of a streamed scene only holds the tiles near the balls
+  if (streamer.isOpen()) {
+    SDL_Log("Streamed scenes can not be saved, ignoring %s", fileName);
+    return;
   }
+  if (!writer.save(fileName, sim))
+    SDL_Log("Still saving %s, ignoring %s", writer.getFileName().c_str(),
+            fileName);
+}
 
-  // Store the triangle indices
-  auto tNum = scene.world.getTriangleNum();
-  for (int i = 0; i < tNum; i++) {
-    GLuint a, b, c;
-    scene.world.getTriangleIdx(i, &a, &b, &c);
-    // Important that obj indexing starts from 1
-    os << "f " << (a + 1) << ' ' << (b + 1) << ' ' << (c + 1) << '\n';
+/**
+ * Logs the result of the finished save, and starts an autosave into
+ * autosave.scene when it is time for one.
+ */
+void Scene3D::updateSaving() {
+  if (writer.poll()) {
+    const char* fName = writer.getFileName().c_str();
+    if (!writer.hasSucceeded())
+      SDL_Log("Could not write file: %s", fName);
+    else
+      SDL_Log("Saved %s (%.2f ms snapshot, %.2f ms writing)", fName,
+              writer.getSnapshotNs() / 1e6, writer.getWriteNs() / 1e6);
   }
+  if (autosaveNs == 0 || streamer.isOpen()) return;
+  uint64_t now = FrameRecorder::now();
+  if (now - lastAutosaveNs < autosaveNs || writer.isSaving()) return;
+  TRACE_ZONE("autosave");
+  lastAutosaveNs = now;
+  writer.save("autosave.scene", sim);
+}
 
-  return os;
+/**
+ * Saves the scene into autosave.scene every given seconds, or never if the
+ * interval is not positive.
+ */
+void Scene3D::setAutosave(float seconds) {
+  autosaveNs = seconds > 0 ? (uint64_t)(seconds * 1e9) : 0;
+  lastAutosaveNs = FrameRecorder::now();
 }
 
 /**
- * Loads a scene from a file.
+ * Restores the newest snapshot of the rewind ring, pressing it again goes
+ * further back. The recorded input can not be rewound, so this does nothing
+ * while recording or replaying.
  */
-std::istream& operator>>(std::istream& is, Scene3D& scene) {
-  std::string line;
-  scene.clearBalls();
-  // Load the balls in the scene described in the starting lines of the file
-  while (std::getline(is, line)) {
-    // If the line describes a ball, load it
-    if ((line.length() >= 6) && line[0] == '#' && line[1] == 'b' &&
-        line[2] == 'a' && line[3] == 'l' && line[4] == 'l' && line[5] == ' ') {
-      std::istringstream loader(line.substr(6));
-      float x, y, z, r, density, angularMMult, bounciness, fc;
-      loader >> x >> y >> z >> r >> density >> angularMMult >> bounciness >> fc;
-      Ball newBall(Vec3(x, y, z), r);
-      // Set the attributes of the newly loaded ball
-      newBall.setDensity(density);
-      newBall.setAngularMassMultiplier(angularMMult);
-      newBall.setBounciness(bounciness);
-      newBall.setFrictionCoefficient(fc);
-      scene.addBall(newBall);
-    } else
-      break;
-  }
-
-  // Then load the rest of the file as a basic obj
-  is >> scene.world;
-  // Load the scene into GPU memory
-  // A good thing is that OpenGL deletes the old geometry data if this is not
-  // the first scene loaded
-  scene.world.loadToGL();
+void Scene3D::rewind() {
+  if (recordingInput || replayingInput) {
+    SDL_Log("Can not rewind while recording or replaying the input");
+    return;
+  }
+  uint64_t from = sim.getStepCount();
+  if (!rewindRing.pop(sim)) {
+    SDL_Log("No earlier state to rewind to");
+    return;
+  }
+  emitterActive = false;
+  framesSinceSnapshot = 0;
+  SDL_Log("Rewound %llu steps, %d snapshots left",
+          (unsigned long long)(from - sim.getStepCount()), rewindRing.size());
+}
 
-  return is;
+/**
+ * Saves the whole dynamic state of the simulation into a binary file.
+ */
+void Scene3D::saveState(const char* fileName) const {
+  StateSnapshot snapshot;
+  snapshot.capture(sim);
+  if (snapshot.save(fileName))
+    SDL_Log("Saved the state of %d balls into %s", snapshot.getBallCount(),
+            fileName);
+  else
+    SDL_Log("Could not write file: %s", fileName);
 }
 
 /**
- * Saves the scene with the given file name.
+ * Continues the simulation from a state saved by saveState. The state has to
+ * be saved with the current world geometry.
  */
-void Scene3D::saveScene(const char* fileName) const {
+void Scene3D::loadState(const char* fileName) {
+  if (recordingInput || replayingInput) {
+    SDL_Log("Can not load a state while recording or replaying the input");
+    return;
+  }
+  StateSnapshot snapshot;
+  if (!snapshot.load(fileName)) {
+    SDL_Log("Could not open and read file: %s", fileName);
+    return;
+  }
+  snapshot.restore(sim);
+  emitterActive = false;
+  rewindRing.clear();
+  framesSinceSnapshot = 0;
+  SDL_Log("Loaded the state of %d balls from %s", snapshot.getBallCount(),
+          fileName);
+}
+
+/**
+ * Saves the collision costs of the world triangles counted since the heatmap
+ * was last shown into a CSV file.
+ */
+void Scene3D::saveHeatmap(const char* fileName) const {
   std::ofstream saveFile(fileName);
   if (saveFile.is_open()) {
-    saveFile << (*this);
+    sim.getHeatmap().writeCsv(saveFile, world);
     saveFile.close();
+    SDL_Log("Saved the collision heatmap into %s", fileName);
   }
 }
 
@@ -541,6 +1217,15 @@ void Scene3D::saveScene(const char* fileName) const {
 void Scene3D::handleEvents() {
   SDL_Event e;
   while (SDL_PollEvent(&e)) {
+    // Remember when the oldest input of the frame happened, SDL timestamps
+    // are in milliseconds since the start of SDL_GetTicks
+    if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP ||
+        e.type == SDL_MOUSEMOTION || e.type == SDL_MOUSEBUTTONDOWN) {
+      uint64_t age = (uint64_t)(SDL_GetTicks() - e.common.timestamp) * 1000000;
+      uint64_t happened = FrameRecorder::now() - age;
+      if (oldestInputNs == 0 || happened < oldestInputNs)
+        oldestInputNs = happened;
+    }
     switch (e.type) {
       case SDL_QUIT:
         isRunning = false;
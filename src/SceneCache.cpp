@@ -0,0 +1,163 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "SceneCache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#include "MemoryStats.h"
+
+/**
+ * Initialises an empty cache keeping at most the given number of bytes.
+ */
+SceneCache::SceneCache(size_t capacity_)
+    : capacity(capacity_), bytes(0), hits(0), misses(0) {}
+
+/**
+ * Removes the entries from the memory accounting.
+ */
+SceneCache::~SceneCache() { evict(0); }
+
+/**
+ * Finds the key of the given file. Returns false if the file does not exist.
+ */
+bool SceneCache::makeKey(const char* fileName, SceneKey& key) {
+  std::error_code error;
+  std::filesystem::path path(fileName);
+  key.size = std::filesystem::file_size(path, error);
+  if (error) return false;
+  key.modified =
+      std::filesystem::last_write_time(path, error).time_since_epoch().count();
+  if (error) return false;
+  path = std::filesystem::absolute(path, error);
+  key.path = path.lexically_normal().string();
+  return !error;
+}
+
+/**
+ * Drops the least recently used entries until the cache holds at most the
+ * given number of bytes. The mutex has to be locked.
+ */
+void SceneCache::evict(size_t limit) {
+  while (bytes > limit && !entries.empty()) {
+    bytes -= entries.back().bytes;
+    MemoryStats::add(SCENE_CACHE_MEMORY, -(int64_t)entries.back().bytes);
+    entries.pop_back();
+  }
+}
+
+/**
+ * Copies the cached scene with the given key into the mesh and the vectors,
+ * and marks it as the most recently used. Returns false if it is not cached.
+ */
+bool SceneCache::find(const SceneKey& key, Mesh& mesh,
+                      std::vector<Ball>& balls,
+                      std::vector<KillVolume>& killVolumes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = std::find_if(entries.begin(), entries.end(),
+                         [&key](const Entry& e) { return e.key == key; });
+  if (it == entries.end()) {
+    misses++;
+    return false;
+  }
+  hits++;
+  entries.splice(entries.begin(), entries, it);
+
+  mesh.releaseArrays();
+  mesh.vertices = new float[it->vertices.size()];
+  mesh.indices = new unsigned int[it->indices.size()];
+  std::copy(it->vertices.begin(), it->vertices.end(), mesh.vertices);
+  std::copy(it->indices.begin(), it->indices.end(), mesh.indices);
+  mesh.vCount = it->vertices.size();
+  mesh.iCount = it->indices.size();
+  mesh.setAccountedBytes(sizeof(float) * mesh.vCount +
+                         sizeof(unsigned int) * mesh.iCount);
+  balls.insert(balls.end(), it->balls.begin(), it->balls.end());
+  killVolumes.insert(killVolumes.end(), it->killVolumes.begin(),
+                     it->killVolumes.end());
+  return true;
+}
+
+/**
+ * Stores a copy of a loaded scene as the most recently used one, replacing
+ * the older version of the same file. Scenes larger than the whole cache are
+ * not stored.
+ */
+void SceneCache::store(const SceneKey& key, const Mesh& mesh,
+                       const std::vector<Ball>& balls,
+                       const std::vector<KillVolume>& killVolumes) {
+  size_t size = sizeof(float) * mesh.vCount +
+                sizeof(unsigned int) * mesh.iCount +
+                sizeof(Ball) * balls.size() +
+                sizeof(KillVolume) * killVolumes.size();
+  std::lock_guard<std::mutex> lock(mutex);
+  auto old = std::find_if(
+      entries.begin(), entries.end(),
+      [&key](const Entry& e) { return e.key.path == key.path; });
+  if (old != entries.end()) {
+    bytes -= old->bytes;
+    MemoryStats::add(SCENE_CACHE_MEMORY, -(int64_t)old->bytes);
+    entries.erase(old);
+  }
+  if (size > capacity) return;
+  evict(capacity - size);
+
+  entries.emplace_front();
+  Entry& e = entries.front();
+  e.key = key;
+  e.vertices.assign(mesh.vertices, mesh.vertices + mesh.vCount);
+  e.indices.assign(mesh.indices, mesh.indices + mesh.iCount);
+  e.balls = balls;
+  e.killVolumes = killVolumes;
+  e.bytes = size;
+  bytes += size;
+  MemoryStats::add(SCENE_CACHE_MEMORY, size);
+}
+
+/**
+ * Changes the most bytes kept, dropping the entries over it.
+ */
+void SceneCache::setCapacity(size_t newCapacity) {
+  std::lock_guard<std::mutex> lock(mutex);
+  capacity = newCapacity;
+  evict(capacity);
+}
+
+/**
+ * Drops every entry.
+ */
+void SceneCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  evict(0);
+}
+
+/**
+ * Returns the bytes of the cached scenes.
+ */
+size_t SceneCache::getBytes() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return bytes;
+}
+
+/**
+ * Returns the number of loads that found their scene in the cache.
+ */
+long SceneCache::getHits() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return hits;
+}
+
+/**
+ * Returns the number of loads that had to read their file.
+ */
+long SceneCache::getMisses() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return misses;
+}
@@ -0,0 +1,233 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "SceneLoader.h"
+
+#include <fstream>
+
+#include "BakedScene.h"
+#include "CompressedScene.h"
+#include "FrameRecorder.h"
+#include "SceneParser.h"
+
+/**
+ * Initialises a loader with no load in progress.
+ */
+SceneLoader::SceneLoader()
+    : finished(false), active(false), succeeded(false), startNs(0), loadNs(0),
+      mesh(NULL), cache(NULL), cacheHit(false), sliced(false),
+      stage(DONE_STAGE), fileSize(0), nextChunk(0), slices(0) {}
+
+/**
+ * Waits for the load in progress to finish.
+ */
+SceneLoader::~SceneLoader() {
+  if (worker.joinable()) worker.join();
+}
+
+/**
+ * Loads the scene in the given file, which is either a baked, a compressed or
+ * a text scene. Returns false if the file could not be read. If a cache is
+ * given, the scene is taken from it when the file did not change since it
+ * was stored, and stored in it otherwise. Baked scenes are mapped without
+ * parsing, so they are never cached.
+ */
+bool SceneLoader::loadFile(const char* fileName, Mesh& mesh,
+                           std::vector<Ball>& balls,
+                           std::vector<KillVolume>& killVolumes,
+                           SceneCache* cache, bool* cacheHit) {
+  if (cacheHit != NULL) *cacheHit = false;
+  if (BakedScene::isBaked(fileName))
+    return BakedScene::load(fileName, mesh, balls, killVolumes);
+  SceneKey key;
+  if (cache != NULL && !SceneCache::makeKey(fileName, key)) cache = NULL;
+  if (cache != NULL && cache->find(key, mesh, balls, killVolumes)) {
+    if (cacheHit != NULL) *cacheHit = true;
+    return true;
+  }
+
+  if (CompressedScene::isCompressed(fileName)) {
+    if (!CompressedScene::load(fileName, mesh, balls, killVolumes))
+      return false;
+  } else {
+    std::ifstream file(fileName);
+    if (!file.is_open()) return false;
+    std::string buffer;
+    SceneParser::readAll(file, buffer);
+    const char* end = buffer.data() + buffer.size();
+    const char* obj =
+        SceneParser::parseHeader(buffer.data(), end, balls, killVolumes);
+    SceneParser::parseObj(obj, end, mesh);
+  }
+  if (cache != NULL) cache->store(key, mesh, balls, killVolumes);
+  return true;
+}
+
+/**
+ * Loads the file into the mesh, this runs on the worker thread.
+ */
+void SceneLoader::run() {
+  finish(loadFile(fileName.c_str(), *mesh, balls, killVolumes, cache,
+                  &cacheHit));
+}
+
+/**
+ * Stores the result of the load and marks it finished.
+ */
+void SceneLoader::finish(bool success) {
+  succeeded = success;
+  loadNs = FrameRecorder::now() - startNs;
+  stage = DONE_STAGE;
+  finished = true;
+}
+
+/**
+ * Starts loading the given file into the mesh, on a background thread or in
+ * time slices done by resume. The mesh must not be used until poll reports
+ * the end of the load. If a load is already in progress, this waits for it
+ * first.
+ */
+void SceneLoader::start(const char* fileName_, Mesh& mesh_, bool inSlices) {
+  if (worker.joinable()) worker.join();
+  fileName = fileName_;
+  mesh = &mesh_;
+  balls.clear();
+  killVolumes.clear();
+  finished = false;
+  active = true;
+  slices = 0;
+  cacheHit = false;
+  startNs = FrameRecorder::now();
+  sliced = inSlices;
+#ifdef __EMSCRIPTEN__
+  // The browser build has no threads
+  if (!sliced) {
+    run();
+    return;
+  }
+#endif
+  if (!sliced) {
+    worker = std::thread(&SceneLoader::run, this);
+    return;
+  }
+
+  // The binary formats load fast enough at once
+  if (BakedScene::isBaked(fileName_) ||
+      CompressedScene::isCompressed(fileName_)) {
+    run();
+    return;
+  }
+  key.path.clear();
+  if (cache != NULL && SceneCache::makeKey(fileName_, key) &&
+      cache->find(key, mesh_, balls, killVolumes)) {
+    cacheHit = true;
+    finish(true);
+    return;
+  }
+  file.close();
+  file.clear();
+  file.open(fileName_, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    finish(false);
+    return;
+  }
+  fileSize = file.tellg();
+  file.seekg(0);
+  buffer.clear();
+  buffer.reserve(fileSize);
+  stage = READ_STAGE;
+}
+
+/**
+ * Does the next piece of a load in time slices. Returns false when the load
+ * has finished.
+ */
+bool SceneLoader::advance() {
+  switch (stage) {
+    case READ_STAGE: {
+      size_t size = buffer.size();
+      buffer.resize(size + sliceBytes);
+      file.read(&buffer[size], sliceBytes);
+      buffer.resize(size + file.gcount());
+      if (file) break;
+      // The whole file is read, split the obj part into pieces
+      file.close();
+      const char* end = buffer.data() + buffer.size();
+      const char* obj =
+          SceneParser::parseHeader(buffer.data(), end, balls, killVolumes);
+      chunks = SceneParser::splitObj(obj, end, (end - obj) / sliceBytes + 1);
+      nextChunk = 0;
+      stage = COUNT_STAGE;
+      break;
+    }
+    case COUNT_STAGE:
+      SceneParser::countChunk(chunks[nextChunk++]);
+      if (nextChunk < chunks.size()) break;
+      SceneParser::allocate(chunks, *mesh);
+      nextChunk = 0;
+      stage = PARSE_STAGE;
+      break;
+    case PARSE_STAGE:
+      SceneParser::parseChunk(chunks[nextChunk++], *mesh);
+      if (nextChunk < chunks.size()) break;
+      // The chunks point into the buffer, free both
+      chunks.clear();
+      std::string().swap(buffer);
+      if (cache != NULL && !key.path.empty())
+        cache->store(key, *mesh, balls, killVolumes);
+      finish(true);
+      return false;
+    default:
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Continues a load in time slices until it finishes or the given time is
+ * used up. At least one piece is done in every call, so the load always
+ * progresses.
+ */
+void SceneLoader::resume(uint64_t budgetNs) {
+  if (!active || finished || !sliced) return;
+  slices++;
+  uint64_t deadline = FrameRecorder::now() + budgetNs;
+  while (advance() && FrameRecorder::now() < deadline) {
+  }
+}
+
+/**
+ * Returns the part of the load that is done, between 0 and 1. Loads on a
+ * background thread only report 0 and 1.
+ */
+float SceneLoader::getProgress() const {
+  if (finished) return 1;
+  if (!sliced) return 0;
+  float chunkPart = chunks.empty() ? 0 : (float)nextChunk / chunks.size();
+  switch (stage) {
+    case READ_STAGE:
+      return fileSize > 0 ? 0.3f * buffer.size() / fileSize : 0;
+    case COUNT_STAGE:
+      return 0.3f + 0.2f * chunkPart;
+    case PARSE_STAGE:
+      return 0.5f + 0.5f * chunkPart;
+    default:
+      return 1;
+  }
+}
+
+/**
+ * Returns true once when the load in progress has finished, after which the
+ * mesh and the results can be used.
+ */
+bool SceneLoader::poll() {
+  if (!active || !finished) return false;
+  if (worker.joinable()) worker.join();
+  active = false;
+  return true;
+}
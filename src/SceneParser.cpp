@@ -0,0 +1,316 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "SceneParser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+namespace {
+
+/**
+ * Returns the end of the line starting at p, which is the position of the
+ * newline character or the end of the buffer.
+ */
+inline const char* lineEnd(const char* p, const char* end) {
+  const char* nl = (const char*)std::memchr(p, '\n', end - p);
+  return nl != NULL ? nl : end;
+}
+
+/**
+ * Returns the start of the line after the one ending at e.
+ */
+inline const char* nextLine(const char* e, const char* end) {
+  return e < end ? e + 1 : end;
+}
+
+/**
+ * Returns true if the character separates the values in a line.
+ */
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/**
+ * Returns the first character from p that is not a blank.
+ */
+inline const char* skipBlank(const char* p, const char* end) {
+  while (p < end && isBlank(*p)) p++;
+  return p;
+}
+
+/**
+ * Returns the first blank character from p.
+ */
+inline const char* skipToken(const char* p, const char* end) {
+  while (p < end && !isBlank(*p)) p++;
+  return p;
+}
+
+/**
+ * Returns true if the line starting at p begins with the given keyword
+ * followed by a blank.
+ */
+inline bool startsWith(const char* p, const char* end, const char* keyword,
+                       size_t length) {
+  return (size_t)(end - p) > length && std::memcmp(p, keyword, length) == 0 &&
+         (p[length] == ' ' || p[length] == '\t');
+}
+
+/**
+ * Parses the next float in the line and moves p past it. Values that can not
+ * be parsed are read as zero.
+ */
+inline float parseFloat(const char*& p, const char* end) {
+  p = skipBlank(p, end);
+  if (p < end && *p == '+') p++;
+  float value = 0;
+#if defined(__cpp_lib_to_chars)
+  auto result = std::from_chars(p, end, value);
+  if (result.ec != std::errc()) value = 0;
+  p = result.ptr;
+#else
+  // The line is always followed by a newline or the terminating zero of the
+  // buffer, so strtof can not read past it
+  char* parsed;
+  value = std::strtof(p, &parsed);
+  p = parsed;
+#endif
+  return value;
+}
+
+/**
+ * Parses the next vertex reference of a face and moves p past it. Texture
+ * and normal indices are skipped, and negative indices are relative to the
+ * number of vertices read before the face.
+ */
+inline unsigned int parseIndex(const char*& p, const char* end,
+                               unsigned int vertNum) {
+  long index = 0;
+  auto result = std::from_chars(p, end, index);
+  p = skipToken(result.ptr, end);
+  return (unsigned int)(index < 0 ? vertNum + index : index - 1);
+}
+
+/**
+ * Calls the function for every chunk, using a thread for each of them except
+ * the first one, which is processed on the calling thread.
+ */
+template <typename F>
+void forEachChunk(std::vector<ObjChunk>& chunks, F function) {
+#ifdef __EMSCRIPTEN__
+  // The browser build has no threads
+  for (ObjChunk& chunk : chunks) function(chunk);
+#else
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunks.size(); i++)
+    workers.emplace_back(function, std::ref(chunks[i]));
+  function(chunks[0]);
+  for (std::thread& worker : workers) worker.join();
+#endif
+}
+
+}  // namespace
+
+/**
+ * Reads the rest of the stream into the buffer. The size is queried first if
+ * the stream supports it, so the buffer only has to be allocated once.
+ */
+void SceneParser::readAll(std::istream& is, std::string& buffer) {
+  buffer.clear();
+  std::streampos start = is.tellg();
+  if (start != std::streampos(-1)) {
+    is.seekg(0, std::ios::end);
+    std::streampos stop = is.tellg();
+    is.seekg(start);
+    if (stop != std::streampos(-1) && stop > start) {
+      buffer.resize(stop - start);
+      is.read(&buffer[0], stop - start);
+      buffer.resize(is.gcount());
+    }
+  }
+  // Read the remainder in pieces if the size was not known in advance
+  char piece[1 << 16];
+  while (is.read(piece, sizeof(piece)) || is.gcount() > 0)
+    buffer.append(piece, is.gcount());
+}
+
+/**
+ * Parses the balls and kill volumes described in the starting lines of a
+ * scene file. The header ends at the first other line, which is skipped if it
+ * is a comment (like the #end line written by the simulation). Returns the
+ * start of the obj part of the file.
+ */
+const char* SceneParser::parseHeader(const char* begin, const char* end,
+                                     std::vector<Ball>& balls,
+                                     std::vector<KillVolume>& killVolumes) {
+  const char* p = begin;
+  while (p < end) {
+    const char* e = lineEnd(p, end);
+    if (startsWith(p, e, "#ball", 5)) {
+      const char* q = p + 5;
+      float x = parseFloat(q, e), y = parseFloat(q, e), z = parseFloat(q, e);
+      Ball newBall(Vec3(x, y, z), parseFloat(q, e));
+      // Set the attributes of the newly loaded ball
+      newBall.setDensity(parseFloat(q, e));
+      newBall.setAngularMassMultiplier(parseFloat(q, e));
+      newBall.setBounciness(parseFloat(q, e));
+      newBall.setFrictionCoefficient(parseFloat(q, e));
+      balls.push_back(newBall);
+    } else if (startsWith(p, e, "#kill", 5)) {
+      // A kill volume is given by the two corners of the box
+      const char* q = p + 5;
+      Vec3 a, b;
+      a.x = parseFloat(q, e);
+      a.y = parseFloat(q, e);
+      a.z = parseFloat(q, e);
+      b.x = parseFloat(q, e);
+      b.y = parseFloat(q, e);
+      b.z = parseFloat(q, e);
+      killVolumes.push_back(KillVolume(a, b));
+    } else {
+      return *p == '#' ? nextLine(e, end) : p;
+    }
+    p = nextLine(e, end);
+  }
+  return end;
+}
+
+/**
+ * Splits the obj part of a file into the given number of chunks of about the
+ * same size, each of them ending at the end of a line.
+ */
+std::vector<ObjChunk> SceneParser::splitObj(const char* begin,
+                                            const char* end, int pieces) {
+  std::vector<ObjChunk> chunks;
+  size_t size = end - begin;
+  const char* p = begin;
+  for (int i = 1; i <= pieces && p < end; i++) {
+    const char* e = i == pieces ? end : begin + size * i / pieces;
+    if (e < p) e = p;
+    e = nextLine(lineEnd(e, end), end);
+    chunks.push_back({p, e, 0, 0, 0, 0});
+    p = e;
+  }
+  if (chunks.empty()) chunks.push_back({begin, end, 0, 0, 0, 0});
+  return chunks;
+}
+
+/**
+ * Counts the vertices and triangles of a chunk. A polygon with n corners is
+ * split into n - 2 triangles.
+ */
+void SceneParser::countChunk(ObjChunk& chunk) {
+  chunk.vertNum = chunk.triangleNum = 0;
+  for (const char* p = chunk.begin; p < chunk.end;) {
+    const char* e = lineEnd(p, chunk.end);
+    if (startsWith(p, e, "v", 1)) {
+      chunk.vertNum++;
+    } else if (startsWith(p, e, "f", 1)) {
+      unsigned int corners = 0;
+      for (const char* q = skipBlank(p + 1, e); q < e; q = skipBlank(q, e)) {
+        q = skipToken(q, e);
+        corners++;
+      }
+      if (corners >= 3) chunk.triangleNum += corners - 2;
+    }
+    p = nextLine(e, chunk.end);
+  }
+}
+
+/**
+ * Parses the vertices and triangles of a chunk into the arrays of the mesh
+ * allocated by allocate, starting at the positions calculated from the
+ * counts of the previous chunks.
+ */
+void SceneParser::parseChunk(const ObjChunk& chunk, Mesh& mesh) {
+  float* v = mesh.vertices + 3 * (size_t)chunk.vertBase;
+  unsigned int* t = mesh.indices + 3 * (size_t)chunk.triangleBase;
+  unsigned int vertNum = chunk.vertBase;
+  for (const char* p = chunk.begin; p < chunk.end;) {
+    const char* e = lineEnd(p, chunk.end);
+    if (startsWith(p, e, "v", 1)) {
+      p++;
+      *v++ = parseFloat(p, e);
+      *v++ = parseFloat(p, e);
+      *v++ = parseFloat(p, e);
+      vertNum++;
+    } else if (startsWith(p, e, "f", 1)) {
+      unsigned int corner[3];
+      int corners = 0;
+      for (p = skipBlank(p + 1, e); p < e; p = skipBlank(p, e)) {
+        unsigned int i = parseIndex(p, e, vertNum);
+        // Every corner after the third forms a triangle with the previous two
+        if (corners >= 2) {
+          if (corners > 2) {
+            corner[0] = corner[1];
+            corner[1] = corner[2];
+          }
+          corner[2] = i;
+          *t++ = corner[0];
+          *t++ = corner[1];
+          *t++ = corner[2];
+        } else {
+          corner[corners] = i;
+        }
+        corners++;
+      }
+    }
+    p = nextLine(e, chunk.end);
+  }
+}
+
+/**
+ * Places the counted chunks after each other in the arrays of the mesh, and
+ * allocates exactly as much memory as they need.
+ */
+void SceneParser::allocate(std::vector<ObjChunk>& chunks, Mesh& mesh) {
+  unsigned int vertNum = 0, triangleNum = 0;
+  for (ObjChunk& chunk : chunks) {
+    chunk.vertBase = vertNum;
+    chunk.triangleBase = triangleNum;
+    vertNum += chunk.vertNum;
+    triangleNum += chunk.triangleNum;
+  }
+
+  // Free up the old memory first
+  mesh.releaseArrays();
+  mesh.vertices = new float[3 * (size_t)vertNum];
+  mesh.indices = new unsigned int[3 * (size_t)triangleNum];
+  mesh.vCount = vertNum * 3;
+  mesh.iCount = triangleNum * 3;
+  mesh.setAccountedBytes(sizeof(float) * mesh.vCount +
+                         sizeof(unsigned int) * mesh.iCount);
+}
+
+/**
+ * Parses the vertices and faces of an obj file into the mesh. Only the v and f
+ * lines are read, everything else is ignored. If threads is 0, the number of
+ * threads is chosen from the size of the file.
+ */
+void SceneParser::parseObj(const char* begin, const char* end, Mesh& mesh,
+                           int threads) {
+  size_t size = end - begin;
+  if (threads <= 0) {
+    threads = std::min<size_t>(size / parallelThreshold + 1, maxThreads);
+    threads = std::min<int>(threads, std::thread::hardware_concurrency());
+  }
+#ifdef __EMSCRIPTEN__
+  threads = 1;
+#endif
+  threads = std::max(threads, 1);
+
+  // Count the elements of the chunks, then parse them into their places
+  std::vector<ObjChunk> chunks = splitObj(begin, end, threads);
+  forEachChunk(chunks, countChunk);
+  allocate(chunks, mesh);
+  forEachChunk(chunks,
+               [&mesh](const ObjChunk& chunk) { parseChunk(chunk, mesh); });
+}
@@ -0,0 +1,240 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "SceneWriter.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "FrameRecorder.h"
+#include "MemoryStats.h"
+
+namespace {
+
+// The longest float written, like -1.17549435e-38
+const size_t maxFloatChars = 16;
+// The longest unsigned int written
+const size_t maxIndexChars = 10;
+
+/**
+ * Writes the float at p in its shortest form that is read back exactly, and
+ * returns the end of it.
+ */
+inline char* writeFloat(char* p, float value) {
+#if defined(__cpp_lib_to_chars)
+  return std::to_chars(p, p + maxFloatChars, value).ptr;
+#else
+  return p + std::snprintf(p, maxFloatChars + 1, "%.9g", value);
+#endif
+}
+
+/**
+ * Writes the keyword and the floats as a line at p, and returns the end of
+ * it.
+ */
+char* writeLine(char* p, const char* keyword, const float* values, int n) {
+  while (*keyword) *p++ = *keyword++;
+  for (int i = 0; i < n; i++) {
+    *p++ = ' ';
+    p = writeFloat(p, values[i]);
+  }
+  *p++ = '\n';
+  return p;
+}
+
+}  // namespace
+
+/**
+ * Initialises a writer that has not saved anything yet.
+ */
+SceneWriter::SceneWriter()
+    : finished(false), active(false), succeeded(false), geometryCopied(false),
+      copiedRevision(0), textRevision(0), snapshotNs(0), writeNs(0) {}
+
+/**
+ * Waits for the save in progress, so the file is always complete.
+ */
+SceneWriter::~SceneWriter() {
+  wait();
+  MemoryStats::set(SAVE_MEMORY, 0);
+}
+
+/**
+ * Replaces the balls with the stored attributes of the balls in the store.
+ * They are in the order of their ids, so the storage order does not matter.
+ */
+void SceneWriter::collectBalls(const BallStore& store,
+                               std::vector<SavedBall>& out) {
+  out.clear();
+  for (unsigned int id = 0; id < store.getIdLimit(); id++) {
+    const Ball* b = store.find(id);
+    if (b == NULL) continue;
+    out.push_back({b->getPosition(), b->getRadius(), b->getDensity(),
+                   b->getAngularMassMultiplier(), b->getBounciness(),
+                   b->getFrictionCoefficient()});
+  }
+}
+
+/**
+ * Writes the scene of the simulation into the stream on the calling thread,
+ * in the same format as the background saves.
+ */
+void SceneWriter::writeScene(std::ostream& os, const Simulation& sim) {
+  std::vector<SavedBall> balls;
+  collectBalls(sim.getBalls(), balls);
+  std::string text;
+  formatHeader(balls, sim.getKillVolumes(), text);
+  os.write(text.data(), text.size());
+  const Mesh& world = sim.getWorld();
+  formatGeometry(world.vertices, world.vCount, world.indices, world.iCount,
+                 text);
+  os.write(text.data(), text.size());
+}
+
+/**
+ * Appends the balls, the kill volumes and the #end line of a scene file to
+ * the text.
+ */
+void SceneWriter::formatHeader(const std::vector<SavedBall>& balls,
+                               const std::vector<KillVolume>& killVolumes,
+                               std::string& out) {
+  size_t start = out.size();
+  out.resize(start + (balls.size() + killVolumes.size()) *
+                         (6 + 9 * (maxFloatChars + 1)) + 5);
+  char* p = &out[start];
+  for (const SavedBall& b : balls) {
+    float values[8];
+    b.getValues(values);
+    p = writeLine(p, "#ball", values, 8);
+  }
+  for (const KillVolume& v : killVolumes) {
+    float values[] = {v.min.x, v.min.y, v.min.z, v.max.x, v.max.y, v.max.z};
+    p = writeLine(p, "#kill", values, 6);
+  }
+  // Indicate that there are no more balls to be read
+  std::memcpy(p, "#end\n", 5);
+  out.resize(p + 5 - out.data());
+}
+
+/**
+ * Replaces the text with the v and f lines of the given vertex and index
+ * arrays. The obj indices start from 1.
+ */
+void SceneWriter::formatGeometry(const float* vertices, size_t vCount,
+                                 const unsigned int* indices, size_t iCount,
+                                 std::string& out) {
+  size_t vertNum = vCount / 3, triangleNum = iCount / 3;
+  out.resize(vertNum * (2 + 3 * (maxFloatChars + 1)) +
+             triangleNum * (2 + 3 * (maxIndexChars + 1)));
+  char* p = &out[0];
+  for (size_t i = 0; i < vertNum; i++)
+    p = writeLine(p, "v", vertices + 3 * i, 3);
+  for (size_t i = 0; i < 3 * triangleNum; i += 3) {
+    *p++ = 'f';
+    for (size_t j = i; j < i + 3; j++) {
+      *p++ = ' ';
+      p = std::to_chars(p, p + maxIndexChars, indices[j] + 1).ptr;
+    }
+    *p++ = '\n';
+  }
+  out.resize(p - out.data());
+}
+
+/**
+ * Reports the memory held by the snapshot and the kept text.
+ */
+void SceneWriter::account() {
+  MemoryStats::set(SAVE_MEMORY,
+                   balls.capacity() * sizeof(SavedBall) +
+                       killVolumes.capacity() * sizeof(KillVolume) +
+                       vertices.capacity() * sizeof(float) +
+                       indices.capacity() * sizeof(unsigned int) +
+                       geometryText.capacity());
+}
+
+/**
+ * Formats the snapshot and writes the file, this runs on the worker thread.
+ * The header and the kept geometry text are written as two large blocks.
+ */
+void SceneWriter::run() {
+  uint64_t start = FrameRecorder::now();
+  if (geometryCopied) {
+    formatGeometry(vertices.data(), vertices.size(), indices.data(),
+                   indices.size(), geometryText);
+    textRevision = copiedRevision;
+    geometryCopied = false;
+    // The copy is not needed until the world changes again
+    std::vector<float>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+  }
+  std::string header;
+  formatHeader(balls, killVolumes, header);
+
+  std::ofstream file(fileName, std::ios::binary);
+  file.write(header.data(), header.size());
+  file.write(geometryText.data(), geometryText.size());
+  file.close();
+  succeeded = !file.fail();
+  account();
+  writeNs = FrameRecorder::now() - start;
+  finished = true;
+}
+
+/**
+ * Starts saving the scene of the simulation into the given file. Only the
+ * balls and the kill volumes are copied, and the world geometry if it was
+ * replaced since the last save. Returns false, without saving, if the last
+ * save is still in progress.
+ */
+bool SceneWriter::save(const char* fileName_, const Simulation& sim) {
+  if (active && !finished) return false;
+  if (worker.joinable()) worker.join();
+  uint64_t start = FrameRecorder::now();
+  fileName = fileName_;
+
+  collectBalls(sim.getBalls(), balls);
+  killVolumes = sim.getKillVolumes();
+  const Mesh& world = sim.getWorld();
+  if (world.getRevision() != textRevision) {
+    vertices.assign(world.vertices, world.vertices + world.vCount);
+    indices.assign(world.indices, world.indices + world.iCount);
+    copiedRevision = world.getRevision();
+    geometryCopied = true;
+  }
+  account();
+  snapshotNs = FrameRecorder::now() - start;
+
+  finished = false;
+  active = true;
+#ifdef __EMSCRIPTEN__
+  // The browser build has no threads
+  run();
+#else
+  worker = std::thread(&SceneWriter::run, this);
+#endif
+  return true;
+}
+
+/**
+ * Returns true once when the save in progress has finished.
+ */
+bool SceneWriter::poll() {
+  if (!active || !finished) return false;
+  if (worker.joinable()) worker.join();
+  active = false;
+  return true;
+}
+
+/**
+ * Waits until the save in progress is written.
+ */
+void SceneWriter::wait() {
+  if (worker.joinable()) worker.join();
+}
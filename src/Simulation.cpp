@@ -0,0 +1,285 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "Simulation.h"
+
+#include "MeshPatch.h"
+#include "SceneLoader.h"
+#include "SceneParser.h"
+#include "SceneWriter.h"
+#include "WorldStreamer.h"
+
+const char* const stepPhaseNames[STEP_PHASE_COUNT] = {
+    "maintenance", "update", "ball_ball", "ball_world", "resolution"};
+
+/**
+ * Initialises an empty simulation colliding with the given world geometry.
+ */
+Simulation::Simulation(Mesh* world_) : world(world_) {
+  gravity = Vec3(0, -200, 0);
+  stepsSinceReorder = 0;
+  stepCount = 0;
+  hasWorldBounds = false;
+  stats = StepStats();
+  heatmapEnabled = false;
+}
+
+/**
+ * Advances the balls by the given time. Every ball is moved first, then the
+ * ball-ball and the ball-world contacts of the moved balls are collected
+ * into the contact arena, and the responses are applied one after the other
+ * in that order.
+ */
+void Simulation::step(float dt) {
+  TRACE_ZONE("physics step");
+  uint64_t phaseStart = FrameRecorder::now();
+  // Stores the time since the end of the previous phase
+  auto endPhase = [&](StepPhase phase) {
+    uint64_t t = FrameRecorder::now();
+    stats.phaseNs[phase] = t - phaseStart;
+    phaseStart = t;
+  };
+
+  stepCount++;
+
+  // Keep spatial neighbours close in memory
+  if (++stepsSinceReorder >= reorderInterval) {
+    TRACE_ZONE("morton reorder");
+    balls.sortByMorton();
+    stepsSinceReorder = 0;
+  }
+
+  // Balls that left the course are not simulated anymore
+  retireLostBalls();
+  endPhase(MAINTENANCE_PHASE);
+
+  int ballCount = balls.size();
+  {
+    TRACE_ZONE("ball update");
+    for (int i = 0; i < ballCount; i++) balls[i].update(dt, gravity);
+  }
+  endPhase(UPDATE_PHASE);
+
+  // Detection phase, this does not modify any of the balls
+  contacts.reset();
+  {
+    TRACE_ZONE("ball-ball detection");
+    for (int i = 0; i < ballCount; i++)
+      for (int j = i + 1; j < ballCount; j++)
+        if (Ball::overlaps(balls[i], balls[j])) contacts.addBallContact(i, j);
+    stats.ballBallTests = (long)ballCount * (ballCount - 1) / 2;
+  }
+  endPhase(BALL_BALL_PHASE);
+  {
+    TRACE_ZONE("ball-world detection");
+    stats.ballWorldTests = 0;
+    // The heatmap has to match the world, which might have been reloaded
+    CollisionHeatmap* h = NULL;
+    if (heatmapEnabled) {
+      if (heatmap.getTriangleNum() != world->getTriangleNum()) resetHeatmap();
+      h = &heatmap;
+    }
+    // A rebuild scans the whole world, which is far more than the cached
+    // geometry tested afterwards
+    stats.cacheRebuilds = 0;
+    for (int i = 0; i < ballCount; i++) {
+      if (!balls[i].isCacheValid(*world)) stats.cacheRebuilds++;
+      stats.ballWorldTests += balls[i].findContacts(*world, i, contacts, h);
+    }
+    stats.rebuildScans =
+        stats.cacheRebuilds *
+        ((long)world->getVertexNum() + (long)world->getTriangleNum());
+  }
+  stats.contacts = contacts.getCount();
+  endPhase(BALL_WORLD_PHASE);
+
+  // Resolution phase
+  TRACE_ZONE("contact resolution");
+  stats.resolved = 0;
+  for (int i = 0; i < contacts.getCount(); i++) {
+    const Contact& c = contacts[i];
+    bool applied;
+    if (c.other >= 0)
+      applied = Ball::collide(balls[c.ball], balls[c.other]);
+    else
+      applied = balls[c.ball].resolveContact(c.point);
+    if (applied) stats.resolved++;
+  }
+  endPhase(RESOLUTION_PHASE);
+
+  // Count the balls that are still moving for the statistics, and measure
+  // the memory of the geometry caches
+  stats.awakeBalls = 0;
+  int64_t cacheBytes = 0;
+  for (int i = 0; i < ballCount; i++) {
+    if (balls[i].getVel().lenSq() > awakeSpeed * awakeSpeed) stats.awakeBalls++;
+    cacheBytes += balls[i].getCacheBytes();
+  }
+  MemoryStats::set(BALL_CACHE_MEMORY, cacheBytes);
+}
+
+/**
+ * Recalculates the box outside of which balls are considered lost from the
+ * bounding box of the world geometry. Balls can fly above the course, so the
+ * box has no upper limit.
+ */
+void Simulation::updateWorldBounds() {
+  Vec3 min, max;
+  if (world->getBounds(&min, &max))
+    setWorldBounds(min, max);
+  else
+    hasWorldBounds = false;
+}
+
+/**
+ * Sets the box of the whole course, for worlds that only hold a part of it
+ * at a time. Balls leaving it are considered lost.
+ */
+void Simulation::setWorldBounds(const Vec3& min, const Vec3& max) {
+  hasWorldBounds = true;
+  Vec3 margin(worldBoundsMargin, worldBoundsMargin, worldBoundsMargin);
+  worldBounds.min = min - margin;
+  worldBounds.max = max + margin;
+  worldBounds.max.y = INFINITY;
+}
+
+/**
+ * Updates the simulation after the patch was applied to the world geometry.
+ * The balls stay where they are, only the geometry caches the changed
+ * triangles could be in are rebuilt, or every cache if the arrays were
+ * resized, as the cached indices may no longer exist. Returns the number of
+ * caches dropped.
+ */
+int Simulation::worldChanged(const MeshPatch& patch) {
+  bool resized = patch.isVertexResized() || patch.isIndexResized();
+  Vec3 min, max;
+  bool bounded = patch.getBounds(&min, &max);
+  int dropped = 0;
+  for (int i = 0; i < balls.size(); i++) {
+    if (resized || (bounded && balls[i].cacheOverlaps(min, max))) {
+      balls[i].invalidateCache();
+      dropped++;
+    }
+  }
+  updateWorldBounds();
+  if (patch.isIndexResized() && heatmapEnabled) resetHeatmap();
+  return dropped;
+}
+
+/**
+ * Updates the simulation after the streamer changed the tiles in the world.
+ * The geometry caches of the balls are moved to the new arrays, except the
+ * ones that lost some of their geometry or could contain a loaded tile,
+ * which are rebuilt. Returns the number of caches dropped.
+ */
+int Simulation::tilesChanged(const WorldStreamer& streamer) {
+  int dropped = 0;
+  for (int i = 0; i < balls.size(); i++) {
+    Ball& b = balls[i];
+    bool near = false;
+    for (int t : streamer.getLoaded()) {
+      const BakedTile& tile = streamer.getTile(t);
+      if (b.cacheOverlaps(tile.min, tile.max)) {
+        near = true;
+        break;
+      }
+    }
+    if (near) {
+      b.invalidateCache();
+      dropped++;
+    } else if (!b.remapCache(streamer.getVertexMap(),
+                             streamer.getTriangleMap())) {
+      dropped++;
+    }
+  }
+  if (heatmapEnabled) resetHeatmap();
+  return dropped;
+}
+
+/**
+ * Removes the balls that are inside a kill volume or have left the bounds of
+ * the world. Their slots are reused by the next spawned balls. Returns the
+ * number of removed balls.
+ */
+int Simulation::retireLostBalls() {
+  int removed = 0;
+  // Iterate backwards, because removal moves the last ball into the gap
+  for (int i = balls.size() - 1; i >= 0; i--) {
+    Vec3 p = balls[i].getPosition();
+    bool lost = hasWorldBounds && !worldBounds.contains(p);
+    for (size_t j = 0; j < killVolumes.size() && !lost; j++)
+      lost = killVolumes[j].contains(p);
+    if (lost) {
+      balls.removeAt(i);
+      removed++;
+    }
+  }
+  return removed;
+}
+
+/**
+ * This function saves the state of the simulation into an obj file (the
+ * balls' positions and other attributes are stored in obj comments). It only
+ * stores the position and size of balls.
+ */
+std::ostream& operator<<(std::ostream& os, const Simulation& sim) {
+  SceneWriter::writeScene(os, sim);
+  return os;
+}
+
+/**
+ * Replaces the balls and kill volumes after the world geometry of a new scene
+ * has been loaded.
+ */
+void Simulation::setScene(const std::vector<Ball>& newBalls,
+                          const std::vector<KillVolume>& newKillVolumes) {
+  clearBalls();
+  killVolumes = newKillVolumes;
+  stepsSinceReorder = 0;
+  stepCount = 0;
+  for (const Ball& b : newBalls) addBall(b);
+  updateWorldBounds();
+  heatmap.reset(heatmapEnabled ? world->getTriangleNum() : 0);
+}
+
+/**
+ * Loads the scene in the given file, which is either a baked, a compressed or
+ * a text scene. Returns false if the file could not be read. The scene is
+ * taken from the cache if it is given and holds the file.
+ */
+bool Simulation::load(const char* fileName, SceneCache* cache) {
+  std::vector<Ball> newBalls;
+  std::vector<KillVolume> newKillVolumes;
+  if (!SceneLoader::loadFile(fileName, *world, newBalls, newKillVolumes,
+                             cache))
+    return false;
+  setScene(newBalls, newKillVolumes);
+  return true;
+}
+
+/**
+ * Loads a scene from a file into the simulation.
+ */
+std::istream& operator>>(std::istream& is, Simulation& sim) {
+  std::string buffer;
+  SceneParser::readAll(is, buffer);
+  const char* end = buffer.data() + buffer.size();
+
+  // Load the balls and kill volumes in the scene described in the starting
+  // lines of the file
+  std::vector<Ball> balls;
+  std::vector<KillVolume> killVolumes;
+  const char* obj =
+      SceneParser::parseHeader(buffer.data(), end, balls, killVolumes);
+
+  // Then load the rest of the file as a basic obj
+  SceneParser::parseObj(obj, end, *sim.world);
+  sim.setScene(balls, killVolumes);
+
+  return is;
+}
@@ -84,6 +84,8 @@ void SphereModel::loadModel() {
     appendIndex(upOffset + i, upOffset + ((i + 1) % resolution), upIdx);
     appendIndex(downOffset + i, downOffset + ((i + 1) % resolution), downIdx);
   }
+
+  setAccountedBytes(sizeof(GLfloat) * vCount + sizeof(GLuint) * iCount);
 }
 
 /**
@@ -103,5 +105,6 @@ void SphereModel::renderStriped(GLint posAttrib, bool side) const {
     else
       glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT,
                      (void*)(sizeof(GLuint) * i * 3));
+    drawCalls++;
   }
 }
@@ -0,0 +1,250 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "StateSnapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include "MemoryStats.h"
+
+// Vec3 has its own copy constructor, but it only copies the coordinates
+static_assert(std::is_standard_layout<BallState>::value,
+              "The ball states are saved as plain memory");
+static_assert(std::is_standard_layout<KillVolume>::value,
+              "The kill volumes are saved as plain memory");
+
+namespace {
+
+const char magic[4] = {'M', 'R', 'S', 'T'};
+const uint32_t byteOrderMark = 0x01020304;
+
+/**
+ * The start of a snapshot file, followed by the ball states, the free ids and
+ * the kill volumes.
+ */
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t byteOrder;   // byteOrderMark in the byte order of the writer
+  uint32_t stateBytes;  // The size of a ball state in the writer build
+  uint32_t ballCount;
+  uint32_t freeCount;
+  uint32_t killCount;
+  uint32_t idLimit;
+  uint64_t stepCount;
+  int32_t stepsSinceReorder;
+  float gravity[3];
+};
+
+}  // namespace
+
+/**
+ * Initialises an empty snapshot.
+ */
+StateSnapshot::StateSnapshot()
+    : idLimit(0), stepsSinceReorder(0), stepCount(0), accountedBytes(0) {}
+
+/**
+ * Removes the arrays of the snapshot from the memory accounting.
+ */
+StateSnapshot::~StateSnapshot() {
+  MemoryStats::add(STATE_MEMORY, -accountedBytes);
+}
+
+/**
+ * Reports the new size of the arrays to the memory accounting.
+ */
+void StateSnapshot::account() {
+  int64_t bytes = balls.capacity() * sizeof(BallState) +
+                  freeIds.capacity() * sizeof(unsigned int) +
+                  killVolumes.capacity() * sizeof(KillVolume);
+  MemoryStats::add(STATE_MEMORY, bytes - accountedBytes);
+  accountedBytes = bytes;
+}
+
+/**
+ * Takes a snapshot of the simulation. The arrays of the previous snapshot are
+ * reused, so taking snapshots repeatedly does not allocate after the first
+ * few.
+ */
+void StateSnapshot::capture(const Simulation& sim) {
+  const BallStore& store = sim.balls;
+  balls.resize(store.size());
+  for (int i = 0; i < store.size(); i++) balls[i] = store[i].getState();
+  freeIds.assign(store.getFreeIds(),
+                 store.getFreeIds() + store.getFreeIdCount());
+  idLimit = store.getIdLimit();
+  killVolumes = sim.killVolumes;
+  gravity = sim.gravity;
+  stepsSinceReorder = sim.stepsSinceReorder;
+  stepCount = sim.stepCount;
+  account();
+}
+
+/**
+ * Puts the simulation back into the state of the snapshot. The world geometry
+ * is not part of the snapshot, it has to be the one it was taken with.
+ */
+void StateSnapshot::restore(Simulation& sim) const {
+  sim.balls.restore(balls.data(), balls.size(), idLimit, freeIds.data(),
+                    freeIds.size());
+  sim.killVolumes = killVolumes;
+  sim.gravity = gravity;
+  sim.stepsSinceReorder = stepsSinceReorder;
+  sim.stepCount = stepCount;
+}
+
+/**
+ * Writes the snapshot into a binary file. Returns false if the file could not
+ * be written.
+ */
+bool StateSnapshot::save(const char* fileName) const {
+  std::ofstream file(fileName, std::ios::binary);
+  if (!file.is_open() || !save(file)) return false;
+  file.close();
+  return !file.fail();
+}
+
+/**
+ * Writes the snapshot into a binary stream, for files that embed it. Returns
+ * false if the stream failed.
+ */
+bool StateSnapshot::save(std::ostream& file) const {
+  FileHeader header = FileHeader();
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.byteOrder = byteOrderMark;
+  header.stateBytes = sizeof(BallState);
+  header.ballCount = balls.size();
+  header.freeCount = freeIds.size();
+  header.killCount = killVolumes.size();
+  header.idLimit = idLimit;
+  header.stepCount = stepCount;
+  header.stepsSinceReorder = stepsSinceReorder;
+  header.gravity[0] = gravity.x;
+  header.gravity[1] = gravity.y;
+  header.gravity[2] = gravity.z;
+  file.write((const char*)&header, sizeof(header));
+  file.write((const char*)balls.data(), balls.size() * sizeof(BallState));
+  file.write((const char*)freeIds.data(),
+             freeIds.size() * sizeof(unsigned int));
+  file.write((const char*)killVolumes.data(),
+             killVolumes.size() * sizeof(KillVolume));
+  return file.good();
+}
+
+/**
+ * Reads a snapshot written by save. Returns false, leaving the snapshot
+ * unchanged, if the file could not be read, was written by an incompatible
+ * build or its ids are inconsistent.
+ */
+bool StateSnapshot::load(const char* fileName) {
+  std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) return false;
+  uint64_t end = file.tellg();
+  file.seekg(0);
+  return load(file, end);
+}
+
+/**
+ * Reads a snapshot written into a stream ending at the given position.
+ * Returns false, leaving the snapshot unchanged, if it could not be read, was
+ * written by an incompatible build, its arrays are longer than the rest of
+ * the stream or its ids are inconsistent.
+ */
+bool StateSnapshot::load(std::istream& file, uint64_t end) {
+  FileHeader header;
+  if (!file.read((char*)&header, sizeof(header)) ||
+      std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+      header.version != version || header.byteOrder != byteOrderMark ||
+      header.stateBytes != sizeof(BallState))
+    return false;
+  // Every id below the limit is either used by a ball or free
+  if ((uint64_t)header.ballCount + header.freeCount != header.idLimit)
+    return false;
+  std::streamoff pos = file.tellg();
+  uint64_t arrayBytes = header.ballCount * (uint64_t)sizeof(BallState) +
+                        header.freeCount * (uint64_t)sizeof(unsigned int) +
+                        header.killCount * (uint64_t)sizeof(KillVolume);
+  if (pos < 0 || (uint64_t)pos > end || arrayBytes > end - pos) return false;
+
+  std::vector<BallState> newBalls(header.ballCount);
+  std::vector<unsigned int> newFreeIds(header.freeCount);
+  std::vector<KillVolume> newKillVolumes(header.killCount);
+  file.read((char*)newBalls.data(), newBalls.size() * sizeof(BallState));
+  file.read((char*)newFreeIds.data(),
+            newFreeIds.size() * sizeof(unsigned int));
+  file.read((char*)newKillVolumes.data(),
+            newKillVolumes.size() * sizeof(KillVolume));
+  if (!file) return false;
+  // Each id has to be used exactly once, by a ball or the free stack
+  std::vector<bool> seen(header.idLimit, false);
+  auto claim = [&seen](unsigned int id) {
+    if (id >= seen.size() || seen[id]) return false;
+    seen[id] = true;
+    return true;
+  };
+  for (const BallState& b : newBalls)
+    if (!claim(b.id)) return false;
+  for (unsigned int id : newFreeIds)
+    if (!claim(id)) return false;
+
+  balls.swap(newBalls);
+  freeIds.swap(newFreeIds);
+  killVolumes.swap(newKillVolumes);
+  idLimit = header.idLimit;
+  gravity = Vec3(header.gravity[0], header.gravity[1], header.gravity[2]);
+  stepsSinceReorder = header.stepsSinceReorder;
+  stepCount = header.stepCount;
+  account();
+  return true;
+}
+
+/**
+ * Allocates the snapshots of a ring holding the given number of them.
+ */
+SnapshotRing::SnapshotRing(int capacity_)
+    : capacity(capacity_), newest(capacity_ - 1), count(0) {
+  snapshots = new StateSnapshot[capacity];
+}
+
+/**
+ * Frees the snapshots.
+ */
+SnapshotRing::~SnapshotRing() { delete[] snapshots; }
+
+/**
+ * Takes a snapshot of the simulation, overwriting the oldest one if the ring
+ * is full.
+ */
+void SnapshotRing::push(const Simulation& sim) {
+  newest = (newest + 1) % capacity;
+  snapshots[newest].capture(sim);
+  if (count < capacity) count++;
+}
+
+/**
+ * Restores the newest snapshot and removes it from the ring, so the next pop
+ * goes further back. Returns false if the ring is empty.
+ */
+bool SnapshotRing::pop(Simulation& sim) {
+  if (count == 0) return false;
+  snapshots[newest].restore(sim);
+  newest = (newest + capacity - 1) % capacity;
+  count--;
+  return true;
+}
+
+/**
+ * Returns a stored snapshot, age 0 is the newest one.
+ */
+const StateSnapshot& SnapshotRing::get(int age) const {
+  return snapshots[(newest + capacity - age) % capacity];
+}
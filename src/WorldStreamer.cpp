@@ -0,0 +1,318 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include "WorldStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "FrameRecorder.h"
+
+namespace {
+
+/**
+ * Returns the squared distance of a point from a box.
+ */
+float boxDistanceSq(const Vec3& p, const Vec3& min, const Vec3& max) {
+  Vec3 closest(std::fmin(std::fmax(p.x, min.x), max.x),
+               std::fmin(std::fmax(p.y, min.y), max.y),
+               std::fmin(std::fmax(p.z, min.z), max.z));
+  return (closest - p).lenSq();
+}
+
+}  // namespace
+
+/**
+ * Initialises a streamer without a scene, keeping at most the given number
+ * of bytes of tiles that are not needed.
+ */
+WorldStreamer::WorldStreamer(size_t budget_)
+    : vertexOffset(0),
+      indexOffset(0),
+      cellSize(1),
+      budget(budget_),
+      residentBytes(0),
+      worldRevision(0),
+      updates(0),
+      viewDistance(400),
+      ballDistance(20) {}
+
+/**
+ * Opens a scene baked with a tile size for streaming, appending its balls and
+ * kill volumes to the vectors. No tile is loaded until the first update.
+ * Returns false if the file could not be read or has no tiles.
+ */
+bool WorldStreamer::open(const char* fileName_, std::vector<Ball>& balls,
+                         std::vector<KillVolume>& killVolumes) {
+  BakedTileIndex index;
+  std::vector<Ball> newBalls;
+  std::vector<KillVolume> newKillVolumes;
+  if (!BakedScene::loadTiles(fileName_, index, newBalls, newKillVolumes) ||
+      index.tiles.empty())
+    return false;
+  close();
+  file.open(fileName_, std::ios::binary);
+  if (!file.is_open()) return false;
+  fileName = fileName_;
+  vertexOffset = index.vertexOffset;
+  indexOffset = index.indexOffset;
+
+  tiles.resize(index.tiles.size());
+  std::vector<float> extents;
+  for (size_t i = 0; i < tiles.size(); i++) {
+    Tile& t = tiles[i];
+    t.info = index.tiles[i];
+    t.resident = t.wanted = false;
+    t.lastWanted = 0;
+    t.vertexBase = t.triangleBase = 0;
+    extents.push_back(std::fmax(t.info.max.x - t.info.min.x,
+                                t.info.max.z - t.info.min.z));
+    if (i == 0) {
+      boundsMin = t.info.min;
+      boundsMax = t.info.max;
+    }
+    boundsMin = Vec3(std::fmin(boundsMin.x, t.info.min.x),
+                     std::fmin(boundsMin.y, t.info.min.y),
+                     std::fmin(boundsMin.z, t.info.min.z));
+    boundsMax = Vec3(std::fmax(boundsMax.x, t.info.max.x),
+                     std::fmax(boundsMax.y, t.info.max.y),
+                     std::fmax(boundsMax.z, t.info.max.z));
+  }
+
+  // The cells are as large as a typical tile, so a point only has to look at
+  // the few tiles around it
+  std::nth_element(extents.begin(), extents.begin() + extents.size() / 2,
+                   extents.end());
+  cellSize = std::fmax(extents[extents.size() / 2], 1.0f);
+  for (size_t i = 0; i < tiles.size(); i++) {
+    const BakedTile& t = tiles[i].info;
+    int64_t x0 = std::floor(t.min.x / cellSize);
+    int64_t x1 = std::floor(t.max.x / cellSize);
+    int64_t z0 = std::floor(t.min.z / cellSize);
+    int64_t z1 = std::floor(t.max.z / cellSize);
+    for (int64_t x = x0; x <= x1; x++)
+      for (int64_t z = z0; z <= z1; z++)
+        cells[getCellKey(x, z)].push_back(i);
+  }
+
+  balls.insert(balls.end(), newBalls.begin(), newBalls.end());
+  killVolumes.insert(killVolumes.end(), newKillVolumes.begin(),
+                     newKillVolumes.end());
+  return true;
+}
+
+/**
+ * Closes the streamed scene. The world mesh keeps the tiles it holds until
+ * it is replaced.
+ */
+void WorldStreamer::close() {
+  file.close();
+  file.clear();
+  fileName.clear();
+  tiles.clear();
+  resident.clear();
+  cells.clear();
+  residentBytes = 0;
+  vertexMap.clear();
+  triangleMap.clear();
+  loaded.clear();
+  evicted.clear();
+}
+
+/**
+ * Marks the tiles within the given distance of a point as wanted.
+ */
+void WorldStreamer::want(const Vec3& p, float distance) {
+  int64_t x0 = std::floor((p.x - distance) / cellSize);
+  int64_t x1 = std::floor((p.x + distance) / cellSize);
+  int64_t z0 = std::floor((p.z - distance) / cellSize);
+  int64_t z1 = std::floor((p.z + distance) / cellSize);
+  for (int64_t x = x0; x <= x1; x++) {
+    for (int64_t z = z0; z <= z1; z++) {
+      auto cell = cells.find(getCellKey(x, z));
+      if (cell == cells.end()) continue;
+      for (int i : cell->second) {
+        Tile& t = tiles[i];
+        if (t.wanted ||
+            boxDistanceSq(p, t.info.min, t.info.max) > distance * distance)
+          continue;
+        t.wanted = true;
+        t.lastWanted = updates;
+      }
+    }
+  }
+}
+
+/**
+ * Reads the geometry of a tile from the file into the arrays, with the
+ * indices moved to start from the given vertex. Returns false if it could
+ * not be read or a triangle uses a vertex of another tile.
+ */
+bool WorldStreamer::readTile(const BakedTile& t, float* vertices,
+                             unsigned int* indices, unsigned int vertexBase) {
+  const uint64_t vertexBytes = 3 * sizeof(float);
+  const uint64_t triangleBytes = 3 * sizeof(unsigned int);
+  file.clear();
+  file.seekg(vertexOffset + vertexBytes * t.firstVertex);
+  file.read((char*)vertices, vertexBytes * t.vertexCount);
+  file.seekg(indexOffset + triangleBytes * t.firstTriangle);
+  file.read((char*)indices, triangleBytes * t.triangleCount);
+  if (!file) return false;
+  for (size_t i = 0; i < 3 * (size_t)t.triangleCount; i++) {
+    if (indices[i] < t.firstVertex ||
+        indices[i] - t.firstVertex >= t.vertexCount)
+      return false;
+    indices[i] = indices[i] - t.firstVertex + vertexBase;
+  }
+  return true;
+}
+
+/**
+ * Loads the tiles near the camera, which may be NULL, and the balls, and
+ * drops the tiles that were not needed for the longest time while the tiles
+ * take more than the budget. The tiles that are needed are always kept, even
+ * if they do not fit. Returns true if the world changed, in which case the
+ * maps of the old indices and the lists of loaded and evicted tiles describe
+ * the changes.
+ */
+bool WorldStreamer::update(Mesh& world, const Vec3* camera,
+                           const BallStore& balls) {
+  TRACE_ZONE("world streaming");
+  updates++;
+  // The tiles are only where they were put if the world was not replaced
+  if (world.getRevision() != worldRevision) {
+    for (int i : resident) tiles[i].resident = false;
+    resident.clear();
+    residentBytes = 0;
+  }
+  for (Tile& t : tiles) t.wanted = false;
+  if (camera != NULL) want(*camera, viewDistance);
+  for (int i = 0; i < balls.size(); i++)
+    want(balls[i].getPosition(), balls[i].getRadius() + ballDistance);
+
+  loaded.clear();
+  evicted.clear();
+  size_t bytes = residentBytes;
+  for (size_t i = 0; i < tiles.size(); i++) {
+    if (tiles[i].wanted && !tiles[i].resident) {
+      loaded.push_back(i);
+      bytes += getTileBytes(tiles[i].info);
+    }
+  }
+  if (bytes > budget) {
+    std::vector<int> unwanted;
+    for (int i : resident)
+      if (!tiles[i].wanted) unwanted.push_back(i);
+    std::sort(unwanted.begin(), unwanted.end(), [this](int a, int b) {
+      return tiles[a].lastWanted < tiles[b].lastWanted;
+    });
+    for (int i : unwanted) {
+      if (bytes <= budget) break;
+      evicted.push_back(i);
+      bytes -= getTileBytes(tiles[i].info);
+    }
+  }
+  if (loaded.empty() && evicted.empty()) return false;
+  rebuild(world);
+  return true;
+}
+
+/**
+ * Replaces the arrays of the world with the kept tiles, in their old order,
+ * followed by the loaded ones. The index maps are filled from the old
+ * positions of the kept tiles.
+ */
+void WorldStreamer::rebuild(Mesh& world) {
+  for (int i : evicted) tiles[i].resident = false;
+  std::vector<int> order;
+  for (int i : resident)
+    if (tiles[i].resident) order.push_back(i);
+  order.insert(order.end(), loaded.begin(), loaded.end());
+
+  size_t vertexNum = 0, triangleNum = 0;
+  for (int i : order) {
+    vertexNum += tiles[i].info.vertexCount;
+    triangleNum += tiles[i].info.triangleCount;
+  }
+  float* vertices = new float[3 * vertexNum];
+  unsigned int* indices = new unsigned int[3 * triangleNum];
+  vertexMap.assign(world.getVertexNum(), removedIndex);
+  triangleMap.assign(world.getTriangleNum(), removedIndex);
+
+  unsigned int v = 0, t = 0;
+  residentBytes = 0;
+  for (int i : order) {
+    Tile& tile = tiles[i];
+    BakedTile& info = tile.info;
+    if (tile.resident) {
+      // A kept tile is moved from its old place in the world
+      const float* from = world.vertices + 3 * (size_t)tile.vertexBase;
+      std::copy(from, from + 3 * (size_t)info.vertexCount,
+                vertices + 3 * (size_t)v);
+      for (size_t k = 0; k < 3 * (size_t)info.triangleCount; k++)
+        indices[3 * (size_t)t + k] =
+            world.indices[3 * (size_t)tile.triangleBase + k] -
+            tile.vertexBase + v;
+      for (unsigned int k = 0; k < info.vertexCount; k++)
+        vertexMap[tile.vertexBase + k] = v + k;
+      for (unsigned int k = 0; k < info.triangleCount; k++)
+        triangleMap[tile.triangleBase + k] = t + k;
+    } else if (!readTile(info, vertices + 3 * (size_t)v,
+                         indices + 3 * (size_t)t, v)) {
+      // A broken tile stays empty instead of being read again and again
+      std::cerr << "Could not open and read file: " << fileName << '\n';
+      info.vertexCount = info.triangleCount = 0;
+    }
+    tile.resident = true;
+    tile.vertexBase = v;
+    tile.triangleBase = t;
+    v += info.vertexCount;
+    t += info.triangleCount;
+    residentBytes += getTileBytes(info);
+  }
+  resident.swap(order);
+
+  world.releaseArrays();
+  world.vertices = vertices;
+  world.vCount = 3 * v;
+  world.indices = indices;
+  world.iCount = 3 * t;
+  world.setAccountedBytes(sizeof(float) * world.vCount +
+                          sizeof(unsigned int) * world.iCount);
+  worldRevision = world.getRevision();
+}
+
+/**
+ * Copies the geometry of a resident tile out of the world, with its indices
+ * starting from 0, so it can be rendered on its own.
+ */
+void WorldStreamer::copyTile(const Mesh& world, int tile, Mesh& out) const {
+  out.releaseArrays();
+  const Tile& t = tiles[tile];
+  if (!t.resident) return;
+  size_t vCount = 3 * (size_t)t.info.vertexCount;
+  size_t iCount = 3 * (size_t)t.info.triangleCount;
+  out.vertices = new float[vCount];
+  out.indices = new unsigned int[iCount];
+  std::copy(world.vertices + 3 * (size_t)t.vertexBase,
+            world.vertices + 3 * (size_t)t.vertexBase + vCount, out.vertices);
+  const unsigned int* from = world.indices + 3 * (size_t)t.triangleBase;
+  for (size_t k = 0; k < iCount; k++) out.indices[k] = from[k] - t.vertexBase;
+  out.vCount = vCount;
+  out.iCount = iCount;
+  out.setAccountedBytes(sizeof(float) * vCount + sizeof(unsigned int) * iCount);
+}
+
+/**
+ * Returns the box of the whole world, including the tiles not loaded.
+ */
+void WorldStreamer::getBounds(Vec3* min, Vec3* max) const {
+  *min = boundsMin;
+  *max = boundsMax;
+}
@@ -0,0 +1,120 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "BakedScene.h"
+#include "CompressedScene.h"
+#include "FrameRecorder.h"
+#include "Mesh.h"
+#include "Simulation.h"
+
+/**
+ * Prints the command line usage of the program.
+ */
+static void printUsage(const char* name) {
+  std::cerr << "Usage: " << name << " <scene file> <output file> [options]\n"
+            << "  --compress   write a compressed scene instead of a baked "
+               "one\n"
+            << "  --step S     grid step of the compressed vertices "
+               "(default 1/1024)\n"
+            << "  --tiles S    split the world into tiles of S units for "
+               "streaming\n";
+}
+
+/**
+ * Returns the size of the given file in bytes.
+ */
+static long fileSize(const char* fileName) {
+  std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+  return file.is_open() ? (long)file.tellg() : 0;
+}
+
+/**
+ * Converts a text scene into a baked or compressed scene, then loads both of
+ * them to compare the sizes and the load times.
+ */
+int main(int argc, char* argv[]) {
+  const char* sceneName = NULL;
+  const char* outName = NULL;
+  bool compress = false;
+  float step = CompressedScene::defaultStep;
+  float tileSize = 0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--compress") == 0)
+      compress = true;
+    else if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc)
+      step = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--tiles") == 0 && i + 1 < argc)
+      tileSize = std::atof(argv[++i]);
+    else if (argv[i][0] != '-' && sceneName == NULL)
+      sceneName = argv[i];
+    else if (argv[i][0] != '-' && outName == NULL)
+      outName = argv[i];
+    else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (outName == NULL) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  Mesh world;
+  Simulation sim(&world);
+  uint64_t start = FrameRecorder::now();
+  if (!sim.load(sceneName)) {
+    std::cerr << "Could not open and read file: " << sceneName << '\n';
+    return 1;
+  }
+  uint64_t textNs = FrameRecorder::now() - start;
+  bool saved = compress ? CompressedScene::save(outName, sim, step)
+                        : BakedScene::save(outName, sim, tileSize);
+  if (!saved) {
+    std::cerr << "Could not write file: " << outName << '\n';
+    return 1;
+  }
+
+  // Check that the new file loads back
+  Mesh outWorld;
+  Simulation out(&outWorld);
+  start = FrameRecorder::now();
+  if (!out.load(outName)) {
+    std::cerr << "Could not open and read file: " << outName << '\n';
+    return 1;
+  }
+  uint64_t outNs = FrameRecorder::now() - start;
+
+  std::cout << outName << ": " << out.getBalls().size() << " balls, "
+            << out.getKillVolumes().size() << " kill volumes, "
+            << outWorld.getVertexNum() << " vertices, "
+            << outWorld.getTriangleNum() << " triangles\n"
+            << "Size: " << fileSize(sceneName) << " bytes as text, "
+            << fileSize(outName) << " bytes "
+            << (compress ? "compressed" : "baked") << '\n'
+            << "Load time: " << textNs / 1e6 << " ms as text, " << outNs / 1e6
+            << " ms " << (compress ? "compressed" : "baked") << '\n';
+
+  // Check that the tiles can be streamed
+  if (!compress && tileSize > 0) {
+    BakedTileIndex index;
+    std::vector<Ball> balls;
+    std::vector<KillVolume> killVolumes;
+    if (!BakedScene::loadTiles(outName, index, balls, killVolumes)) {
+      std::cerr << "Could not open and read file: " << outName << '\n';
+      return 1;
+    }
+    std::cout << "Tiles: " << index.tiles.size() << " of " << tileSize
+              << " units\n";
+  }
+  return 0;
+}
@@ -0,0 +1,311 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BallEmitter.h"
+#include "Matrix.h"
+#include "Mesh.h"
+#include "Simulation.h"
+
+#ifndef MARBLERUN_SOURCE_DIR
+#define MARBLERUN_SOURCE_DIR "."
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Returns the nanoseconds elapsed since the given time point.
+ */
+static double nsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count();
+}
+
+/**
+ * Returns the given percentile of the sorted samples.
+ */
+static double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t idx = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+/**
+ * Returns the ball used for spawning in every benchmark.
+ */
+static Ball benchBall() {
+  Ball b(Vec3(), 5);
+  b.setBounciness(0.15f);
+  b.setFrictionCoefficient(0.3f);
+  return b;
+}
+
+/**
+ * Drops count balls at random positions above the world of the simulation.
+ */
+static void spawnBalls(Simulation& sim, int count, unsigned int seed) {
+  Vec3 min, max;
+  if (count <= 0 || !sim.getWorld().getBounds(&min, &max)) return;
+  BallEmitter emitter(JITTER_EMITTER, count, 0.0f, benchBall());
+  emitter.setBox(Vec3(min.x, max.y, min.z), Vec3(max.x, max.y + 100, max.z));
+  emitter.setSeed(seed);
+  emitter.spawnAll(sim.getBalls());
+}
+
+/**
+ * Settings of a benchmark run, given on the command line.
+ */
+struct BenchOptions {
+  std::vector<std::string> scenes;
+  std::vector<int> ballCounts;
+  int steps = 120;
+  int warmup = 10;
+  unsigned int seed = 1;
+  bool micro = true;
+};
+
+/**
+ * Simulates a scene with the given number of balls and prints the timings of
+ * the physics steps as a JSON object. Returns false if the scene could not
+ * be read.
+ */
+static bool benchScene(const std::string& path, int ballCount,
+                       const BenchOptions& opt, std::ostream& out) {
+  Mesh world;
+  Simulation sim(&world);
+  if (!sim.load(path.c_str())) return false;
+  spawnBalls(sim, ballCount, opt.seed);
+
+  for (int i = 0; i < opt.warmup; i++) sim.step(1.0f / 60.0f);
+
+  // Time only the physics steps
+  std::vector<double> times;
+  times.reserve(opt.steps);
+  long ballBallTests = 0, ballWorldTests = 0, contacts = 0;
+  long cacheRebuilds = 0, rebuildScans = 0;
+  for (int i = 0; i < opt.steps; i++) {
+    Clock::time_point start = Clock::now();
+    sim.step(1.0f / 60.0f);
+    times.push_back(nsSince(start));
+    ballBallTests += sim.getStats().ballBallTests;
+    ballWorldTests += sim.getStats().ballWorldTests;
+    cacheRebuilds += sim.getStats().cacheRebuilds;
+    rebuildScans += sim.getStats().rebuildScans;
+    contacts += sim.getStats().contacts;
+  }
+  std::sort(times.begin(), times.end());
+
+  // Measure the cost of a single narrowphase triangle test. Probe balls are
+  // put on vertices spread over the world, and their caches are built before
+  // the timing, so only the tests of the cached geometry are timed. The much
+  // cheaper tests of the cached vertices are included in the time
+  BallStore& balls = sim.getBalls();
+  ContactArena found;
+  const int probeNum = 64;
+  const int probeRepeats = 100;
+  long triangleTests = 0;
+  double narrowNs = 0;
+  unsigned int vNum = world.getVertexNum();
+  for (int p = 0; p < probeNum && vNum > 0; p++) {
+    Ball probe = benchBall();
+    probe.setPosition(world.getVertex((unsigned long)p * vNum / probeNum));
+    probe.findContacts(world, 0, found);
+    Clock::time_point start = Clock::now();
+    for (int k = 0; k < probeRepeats; k++) {
+      found.reset();
+      probe.findContacts(world, 0, found);
+    }
+    narrowNs += nsSince(start);
+    triangleTests += probeRepeats * (long)probe.getCachedTriangleNum();
+  }
+
+  out << "    {\"scene\": \"" << std::filesystem::path(path).filename().string()
+      << "\", \"triangles\": " << world.getTriangleNum()
+      << ", \"balls\": " << ballCount << ", \"balls_left\": " << balls.size()
+      << ", \"steps\": " << opt.steps
+      << ", \"step_us\": {\"min\": " << times.front() / 1000
+      << ", \"median\": " << percentile(times, 50) / 1000
+      << ", \"p90\": " << percentile(times, 90) / 1000
+      << ", \"p99\": " << percentile(times, 99) / 1000
+      << ", \"max\": " << times.back() / 1000 << "}"
+      << ", \"ball_ball_tests\": " << ballBallTests
+      << ", \"ball_world_tests\": " << ballWorldTests
+      << ", \"cache_rebuilds\": " << cacheRebuilds
+      << ", \"rebuild_scans\": " << rebuildScans
+      << ", \"contacts\": " << contacts << ", \"ns_per_triangle_test\": "
+      << (triangleTests > 0 ? narrowNs / triangleTests : 0) << "}";
+  return true;
+}
+
+/**
+ * Runs the given function repeatedly for a while and returns the average
+ * time of a single call in nanoseconds.
+ */
+template <typename F>
+static double timePerCall(F func, long iterations) {
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < iterations; i++) func();
+  return nsSince(start) / iterations;
+}
+
+/**
+ * Microbenchmarks of the most important building blocks of the physics.
+ * Returns false if the base scene could not be read.
+ */
+static bool benchMicro(const std::string& basePath, std::ostream& out) {
+  // Ball-ball collision of two overlapping balls moving towards each other
+  Ball b1(Vec3(0, 0, 0), 5), b2(Vec3(9, 0, 0), 5);
+  double collideNs = timePerCall(
+      [&]() {
+        b1.setPosition(Vec3(0, 0, 0));
+        b2.setPosition(Vec3(9, 0, 0));
+        b1.setVel(Vec3(10, 0, 0));
+        b2.setVel(Vec3(-10, 0, 0));
+        Ball::collide(b1, b2);
+      },
+      1000000);
+
+  // Ball-world collision against the base scene, with and without the cache
+  std::ifstream file(basePath);
+  if (!file.is_open()) return false;
+  std::stringstream content;
+  content << file.rdbuf();
+  Mesh world;
+  std::istringstream parseStream(content.str());
+  parseStream >> world;
+  Vec3 min, max;
+  world.getBounds(&min, &max);
+  Ball ball((min + max) * 0.5f, 5);
+  ContactArena found(16);
+  double modelCachedNs = timePerCall(
+      [&]() {
+        ball.setVel(Vec3(0, -1, 0));
+        ball.collideWithModel(world, found);
+      },
+      10000);
+  double modelFullNs = timePerCall(
+      [&]() {
+        ball.invalidateCache();
+        ball.collideWithModel(world, found);
+      },
+      200);
+
+  // Matrix multiplication
+  Matrix m = Matrix::rotation(0.1f, 0, 1, 0);
+  Matrix acc;
+  double multNs = timePerCall([&]() { acc.mult(m); }, 1000000);
+
+  // Parsing the base scene as an obj file
+  double parseNs = timePerCall(
+      [&]() {
+        std::istringstream is(content.str());
+        Mesh parsed;
+        is >> parsed;
+      },
+      5);
+
+  out << "  \"micro_ns\": {\"ball_collide\": " << collideNs
+      << ", \"collide_with_model_cached\": " << modelCachedNs
+      << ", \"collide_with_model_full\": " << modelFullNs
+      << ", \"matrix_mult\": " << multNs
+      << ", \"obj_parse_base_scene\": " << parseNs
+      << ", \"checksum\": " << acc.getElements()[0] + b1.getVel().x << "}";
+  return true;
+}
+
+/**
+ * Parses a comma separated list of integers.
+ */
+static std::vector<int> parseList(const char* s) {
+  std::vector<int> ret;
+  std::istringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) ret.push_back(std::atoi(item.c_str()));
+  return ret;
+}
+
+/**
+ * Benchmarks the physics step on every scene in the scenes folder and the base
+ * scene with different numbers of balls, then prints the results as JSON.
+ */
+int main(int argc, char* argv[]) {
+  BenchOptions opt;
+  opt.ballCounts = {10, 100, 1000};
+  std::string root = MARBLERUN_SOURCE_DIR;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "--root") == 0 && hasValue)
+      root = argv[++i];
+    else if (std::strcmp(argv[i], "--scene") == 0 && hasValue)
+      opt.scenes.push_back(argv[++i]);
+    else if (std::strcmp(argv[i], "--balls") == 0 && hasValue)
+      opt.ballCounts = parseList(argv[++i]);
+    else if (std::strcmp(argv[i], "--steps") == 0 && hasValue)
+      opt.steps = std::max(1, std::atoi(argv[++i]));
+    else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue)
+      opt.warmup = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+      opt.seed = std::strtoul(argv[++i], NULL, 10);
+    else if (std::strcmp(argv[i], "--no-micro") == 0)
+      opt.micro = false;
+    else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--root dir] [--scene file]... [--balls 10,100,1000]"
+                   " [--steps N] [--warmup N] [--seed S] [--no-micro]\n";
+      return 1;
+    }
+  }
+
+  // By default every scene in the scenes folder and the base scene are used
+  std::string basePath = root + "/base.scene";
+  if (opt.scenes.empty()) {
+    std::error_code ec;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(root + "/scenes", ec))
+      if (entry.path().extension() == ".scene")
+        opt.scenes.push_back(entry.path().string());
+    std::sort(opt.scenes.begin(), opt.scenes.end());
+    opt.scenes.push_back(basePath);
+  }
+
+  std::ostream& out = std::cout;
+  out << "{\n  \"seed\": " << opt.seed << ",\n  \"results\": [\n";
+  bool first = true;
+  for (const std::string& scene : opt.scenes) {
+    for (int count : opt.ballCounts) {
+      std::cerr << "Benchmarking " << scene << " with " << count << " balls\n";
+      if (!first) out << ",\n";
+      if (!benchScene(scene, count, opt, out)) {
+        std::cerr << "Could not open and read file: " << scene << '\n';
+        return 1;
+      }
+      first = false;
+    }
+  }
+  out << "\n  ]";
+  if (opt.micro) {
+    out << ",\n";
+    if (!benchMicro(basePath, out)) {
+      std::cerr << "Could not open and read file: " << basePath << '\n';
+      return 1;
+    }
+  }
+  out << "\n}\n";
+
+  return 0;
+}
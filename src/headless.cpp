@@ -0,0 +1,383 @@
+/**
+ * ©·2021·Ákos Seres
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "BallEmitter.h"
+#include "FrameRecorder.h"
+#include "GoldenTrajectory.h"
+#include "InputRecording.h"
+#include "MemoryStats.h"
+#include "Mesh.h"
+#include "MetricsLog.h"
+#include "Simulation.h"
+#include "StateSnapshot.h"
+#include "WorldStreamer.h"
+
+/**
+ * Prints the command line usage of the program.
+ */
+static void printUsage(const char* name) {
+  std::cerr << "Usage: " << name << " <scene file> [options]\n"
+            << "       " << name << " --replay F [options]\n"
+            << "  --replay F   replay the input recorded in the app into F\n"
+            << "  --steps N    number of steps to simulate (default 600)\n"
+            << "  --dt T       length of a step in seconds (default 1/60)\n"
+            << "  --balls N    spawn N extra balls above the scene\n"
+            << "  --seed S     seed used for spawning the extra balls\n"
+            << "  --trace F    write the last frames as a Chrome trace into F\n"
+            << "  --metrics F  write per-step metrics as JSON lines into F\n"
+            << "  --heatmap F  write the per-triangle collision costs into F\n"
+            << "  --golden-write F  store the ball trajectories into F\n"
+            << "  --golden-check F  compare the trajectories with F\n"
+            << "  --golden-every N  sample the trajectories every N steps "
+               "(default 60)\n"
+            << "  --tolerance T     allowed relative error (default 1e-4)\n"
+            << "  --max-slowdown X  fail if the median step is more than X "
+               "times the golden one\n"
+            << "  --max-step-ms M   fail if the median step is over M ms\n"
+            << "  --resume F   continue from the state saved into F\n"
+            << "  --checkpoint F    save the final state into F\n"
+            << "  --stream-mb M     stream the tiles of a tiled baked scene, "
+               "keeping about M MB\n"
+            << "  --quiet      do not print the final state of the balls\n";
+}
+
+/**
+ * Carries out a recorded action of the user, the same way the app does. The
+ * camera is not needed, every action stores where it happened.
+ */
+static void applyInput(const InputEvent& e, Simulation& sim,
+                       BallEmitter& emitter, bool& emitterActive,
+                       bool& timeStopped) {
+  switch (e.type) {
+    case PLACE_BALL_INPUT:
+      sim.addBall(e.makeBall());
+      break;
+    case CLEAR_BALLS_INPUT:
+      sim.clearBalls();
+      emitterActive = false;
+      break;
+    case TIME_STOP_INPUT:
+      timeStopped = e.flag;
+      break;
+    case EMITTER_START_INPUT:
+      emitter = e.makeEmitter();
+      emitter.start(sim.getBalls());
+      emitterActive = true;
+      break;
+    case EMITTER_STOP_INPUT:
+      emitterActive = false;
+      break;
+    case EMITTER_STREAM_INPUT:
+      emitter.setStream(e.pos, e.vel);
+      break;
+    case LOAD_SCENE_INPUT:
+      if (!sim.load(e.path.c_str()))
+        std::cerr << "Could not open and read file: " << e.path << '\n';
+      emitterActive = false;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Loads a scene, simulates it without a window as fast as possible, then
+ * prints the final state of the balls and the achieved steps per second.
+ */
+int main(int argc, char* argv[]) {
+  const char* sceneName = NULL;
+  const char* replayName = NULL;
+  int steps = 600;
+  float dt = 1.0f / 60.0f;
+  int extraBalls = 0;
+  unsigned int seed = 1;
+  bool quiet = false;
+  const char* traceName = NULL;
+  const char* metricsName = NULL;
+  const char* heatmapName = NULL;
+  const char* goldenWriteName = NULL;
+  const char* goldenCheckName = NULL;
+  int goldenEvery = 60;
+  float tolerance = 1e-4f;
+  double maxSlowdown = 0;
+  double maxStepMs = 0;
+  const char* resumeName = NULL;
+  const char* checkpointName = NULL;
+  double streamMb = 0;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (argv[i][0] != '-' && sceneName == NULL)
+      sceneName = argv[i];
+    else if (std::strcmp(argv[i], "--replay") == 0 && hasValue)
+      replayName = argv[++i];
+    else if (std::strcmp(argv[i], "--steps") == 0 && hasValue)
+      steps = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--dt") == 0 && hasValue)
+      dt = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--balls") == 0 && hasValue)
+      extraBalls = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+      seed = std::strtoul(argv[++i], NULL, 10);
+    else if (std::strcmp(argv[i], "--trace") == 0 && hasValue)
+      traceName = argv[++i];
+    else if (std::strcmp(argv[i], "--metrics") == 0 && hasValue)
+      metricsName = argv[++i];
+    else if (std::strcmp(argv[i], "--heatmap") == 0 && hasValue)
+      heatmapName = argv[++i];
+    else if (std::strcmp(argv[i], "--golden-write") == 0 && hasValue)
+      goldenWriteName = argv[++i];
+    else if (std::strcmp(argv[i], "--golden-check") == 0 && hasValue)
+      goldenCheckName = argv[++i];
+    else if (std::strcmp(argv[i], "--golden-every") == 0 && hasValue)
+      goldenEvery = std::max(1, std::atoi(argv[++i]));
+    else if (std::strcmp(argv[i], "--tolerance") == 0 && hasValue)
+      tolerance = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--max-slowdown") == 0 && hasValue)
+      maxSlowdown = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--max-step-ms") == 0 && hasValue)
+      maxStepMs = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--resume") == 0 && hasValue)
+      resumeName = argv[++i];
+    else if (std::strcmp(argv[i], "--checkpoint") == 0 && hasValue)
+      checkpointName = argv[++i];
+    else if (std::strcmp(argv[i], "--stream-mb") == 0 && hasValue)
+      streamMb = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--quiet") == 0)
+      quiet = true;
+    else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if ((sceneName == NULL) == (replayName == NULL)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  // Load the scene, a replay starts from the scene stored in the recording
+  Mesh world;
+  Simulation sim(&world);
+  InputRecording replay;
+  WorldStreamer streamer(streamMb * 1048576);
+  bool streaming = replayName == NULL && streamMb > 0;
+  if (streaming) {
+    // Only the tiles near the balls are loaded, before every step
+    std::vector<Ball> newBalls;
+    std::vector<KillVolume> newKillVolumes;
+    if (!streamer.open(sceneName, newBalls, newKillVolumes)) {
+      std::cerr << "Could not open and read file: " << sceneName << '\n';
+      return 1;
+    }
+    sim.setScene(newBalls, newKillVolumes);
+  } else if (replayName != NULL) {
+    if (!replay.load(replayName)) {
+      std::cerr << "Could not open and read file: " << replayName << '\n';
+      return 1;
+    }
+    replay.restore(sim);
+    sceneName = replayName;
+    steps = replay.getFrameCount();
+    dt = replay.getDt();
+  } else if (!sim.load(sceneName)) {
+    std::cerr << "Could not open and read file: " << sceneName << '\n';
+    return 1;
+  }
+
+  // Drop the extra balls at random positions above the world
+  Vec3 min, max;
+  if (streaming) {
+    streamer.getBounds(&min, &max);
+    sim.setWorldBounds(min, max);
+  }
+  if (replayName == NULL && extraBalls > 0 &&
+      (streaming || world.getBounds(&min, &max))) {
+    Ball proto(Vec3(), 5);
+    proto.setBounciness(0.15f);
+    proto.setFrictionCoefficient(0.3f);
+    BallEmitter emitter(JITTER_EMITTER, extraBalls, 0.0f, proto);
+    emitter.setBox(Vec3(min.x, max.y, min.z), Vec3(max.x, max.y + 100, max.z));
+    emitter.setSeed(seed);
+    emitter.spawnAll(sim.getBalls());
+  }
+
+  // A saved state replaces the balls of the scene
+  if (resumeName != NULL) {
+    StateSnapshot snapshot;
+    if (!snapshot.load(resumeName)) {
+      std::cerr << "Could not open and read file: " << resumeName << '\n';
+      return 1;
+    }
+    snapshot.restore(sim);
+    std::cout << "Resuming " << resumeName << " at step "
+              << snapshot.getStepCount() << '\n';
+  }
+
+  if (streaming) {
+    std::cout << "Streaming " << sceneName << ": " << streamer.getTileNum()
+              << " tiles, " << sim.getBalls().size() << " balls\n";
+  } else {
+    std::cout << "Loaded " << sceneName << ": " << world.getTriangleNum()
+              << " triangles, " << sim.getBalls().size() << " balls\n";
+  }
+  MemoryStats::print(std::cout);
+
+  MetricsLog metrics;
+  if (metricsName != NULL && !metrics.open(metricsName)) {
+    std::cerr << "Could not write file: " << metricsName << '\n';
+    return 1;
+  }
+
+  sim.setHeatmapEnabled(heatmapName != NULL);
+
+  // The state changed by the replayed input
+  BallEmitter emitter;
+  bool emitterActive = false;
+  bool timeStopped = replay.isStartStopped();
+
+  // The trajectories are sampled for the golden files, starting with the
+  // initial state
+  GoldenTrajectory trajectory;
+  bool sampleTrajectory = goldenWriteName != NULL || goldenCheckName != NULL;
+  if (sampleTrajectory) trajectory.capture(0, sim.getBalls());
+  LatencyHistogram stepTimes;
+
+  // Simulate, every step is a frame for the flight recorder and the metrics
+  FrameRecorder::setEnabled(traceName != NULL);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < steps; i++) {
+    FrameRecorder::beginFrame();
+    // Apply the recorded input of the frame, then update like the app does
+    const InputEvent* e;
+    while ((e = replay.next(i)) != NULL)
+      applyInput(*e, sim, emitter, emitterActive, timeStopped);
+    if (timeStopped) {
+      FrameRecorder::endFrame();
+      continue;
+    }
+    if (emitterActive) {
+      emitter.update(dt, sim.getBalls());
+      if (emitter.isFinished()) emitterActive = false;
+    }
+    uint64_t stepStart = FrameRecorder::now();
+    if (streaming && streamer.update(world, NULL, sim.getBalls()))
+      sim.tilesChanged(streamer);
+    sim.step(dt);
+    uint64_t stepNs = FrameRecorder::now() - stepStart;
+    FrameRecorder::endFrame();
+    stepTimes.record(stepNs);
+    if (sampleTrajectory && (i + 1) % goldenEvery == 0)
+      trajectory.capture(i + 1, sim.getBalls());
+    if (metrics.isOpen()) {
+      FrameMetrics m = FrameMetrics();
+      m.frame = i;
+      m.frameNs = m.stepNs = stepNs;
+      m.balls = sim.getBalls().size();
+      m.step = sim.getStats();
+      metrics.record(m);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // Print the final state of the balls in the order of their ids
+  const BallStore& balls = sim.getBalls();
+  if (!quiet) {
+    for (unsigned int id = 0; id < balls.getIdLimit(); id++) {
+      const Ball* b = balls.find(id);
+      if (b == NULL) continue;
+      Vec3 p = b->getPosition(), v = b->getVel();
+      std::cout << "ball " << id << " pos " << p.x << ' ' << p.y << ' ' << p.z
+                << " vel " << v.x << ' ' << v.y << ' ' << v.z << '\n';
+    }
+  }
+  std::cout << steps << " steps, " << balls.size() << " balls left, "
+            << elapsed.count() << " s, "
+            << (elapsed.count() > 0 ? steps / elapsed.count() : 0)
+            << " steps/s\n";
+  std::cout << "Peak memory " << MemoryStats::getTotalPeak() / 1024.0
+            << " KiB\n";
+  if (streaming)
+    std::cout << streamer.getResidentNum() << " of " << streamer.getTileNum()
+              << " tiles resident, " << streamer.getResidentBytes() / 1024.0
+              << " KiB\n";
+
+  if (metrics.isOpen()) {
+    const LatencyHistogram& h = metrics.getStepTimes();
+    std::cout << "step ms p50 " << h.getPercentile(50) / 1e6 << " p90 "
+              << h.getPercentile(90) / 1e6 << " p99 "
+              << h.getPercentile(99) / 1e6 << " p99.9 "
+              << h.getPercentile(99.9) / 1e6 << " max " << h.getMax() / 1e6
+              << '\n';
+    metrics.close();
+  }
+
+  if (heatmapName != NULL) {
+    std::ofstream heatmapFile(heatmapName);
+    if (!heatmapFile.is_open()) {
+      std::cerr << "Could not write file: " << heatmapName << '\n';
+      return 1;
+    }
+    sim.getHeatmap().writeCsv(heatmapFile, world);
+  }
+
+  if (checkpointName != NULL) {
+    StateSnapshot snapshot;
+    snapshot.capture(sim);
+    if (!snapshot.save(checkpointName)) {
+      std::cerr << "Could not write file: " << checkpointName << '\n';
+      return 1;
+    }
+  }
+
+  if (traceName != NULL && !FrameRecorder::dump(traceName)) {
+    std::cerr << "Could not write file: " << traceName << '\n';
+    return 1;
+  }
+
+  // The median is used for the performance checks, it is not thrown off by a
+  // few slow steps
+  double stepMs = stepTimes.getPercentile(50) / 1e6;
+  trajectory.setStepMs(stepMs);
+  if (goldenWriteName != NULL && !trajectory.save(goldenWriteName)) {
+    std::cerr << "Could not write file: " << goldenWriteName << '\n';
+    return 1;
+  }
+
+  int result = 0;
+  if (goldenCheckName != NULL) {
+    GoldenTrajectory golden;
+    if (!golden.load(goldenCheckName)) {
+      std::cerr << "Could not open and read file: " << goldenCheckName << '\n';
+      return 1;
+    }
+    if (!trajectory.compare(golden, tolerance, std::cout)) {
+      std::cout << "Trajectories differ from " << goldenCheckName << '\n';
+      result = 2;
+    }
+    double allowed = maxSlowdown * golden.getStepMs();
+    if (maxSlowdown > 0 && golden.getStepMs() > 0 && stepMs > allowed) {
+      std::cout << "Median step " << stepMs << " ms, golden "
+                << golden.getStepMs() << " ms, allowed " << allowed << " ms\n";
+      if (result == 0) result = 3;
+    }
+  }
+  if (maxStepMs > 0 && stepMs > maxStepMs) {
+    std::cout << "Median step " << stepMs << " ms, allowed " << maxStepMs
+              << " ms\n";
+    if (result == 0) result = 3;
+  }
+
+  return result;
+}
@@ -1,8 +1,40 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "FrameRecorder.h"
 #include "Scene3D.h"
 
 int main(int argc, char *argv[]) {
   // Create app instance
   Scene3D app = Scene3D("3D Physics sandbox");
+  // Write per-frame metrics with --metrics <file>, replay recorded input
+  // with --replay <file>, time the presentation after glFinish with
+  // --gl-finish, load dropped scenes in time slices with --sliced-loading,
+  // save the scene into autosave.scene periodically with --autosave <seconds>,
+  // keep at most the given megabytes of loaded scenes with --scene-cache-mb,
+  // reload the scene whenever its file changes with --watch, keep at most
+  // about the given megabytes of streamed tiles with --stream-budget-mb, dump
+  // the flight recorder after frames slower than the given milliseconds with
+  // --hitch-dump
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--gl-finish") == 0)
+      app.setFinishBeforeTiming(true);
+    if (std::strcmp(argv[i], "--sliced-loading") == 0)
+      app.setSlicedLoading(true);
+    if (std::strcmp(argv[i], "--watch") == 0) app.setWatchingScene(true);
+    if (i + 1 >= argc) break;
+    if (std::strcmp(argv[i], "--metrics") == 0 && !app.openMetrics(argv[i + 1]))
+      SDL_LogWarn(0, "Could not write file: %s", argv[i + 1]);
+    if (std::strcmp(argv[i], "--replay") == 0) app.startReplay(argv[i + 1]);
+    if (std::strcmp(argv[i], "--autosave") == 0)
+      app.setAutosave(std::atof(argv[i + 1]));
+    if (std::strcmp(argv[i], "--scene-cache-mb") == 0)
+      app.setSceneCacheSize(std::atof(argv[i + 1]) * 1048576);
+    if (std::strcmp(argv[i], "--stream-budget-mb") == 0)
+      app.setStreamBudget(std::atof(argv[i + 1]) * 1048576);
+    if (std::strcmp(argv[i], "--hitch-dump") == 0)
+      FrameRecorder::setHitchDump(std::atof(argv[i + 1]));
+  }
   // Enter main loop
   app.enterLoop();
 